@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace clipboard {
+    /**
+     * Source of clipboard changes and sink of cleaned text.
+     *
+     * Cleaning loop takes text on every change and puts result back,
+     * so it works the same way with real clipboard and headless ones.
+     *
+     * Change, that is made by own write, is dropped without calling back, as there is nothing to clean.
+     * It is recognized by sequence number of clipboard, which stays the same until someone else writes.
+     */
+    class Backend {
+        protected:
+            ///Sequence number after the last own write.
+            std::atomic<uint64_t> own_seq;
+            std::atomic<uint64_t> dropped;
+
+        public:
+            ///Called on every change of clipboard.
+            typedef std::function<void()> Callback;
+            ///Called with current text, which is valid only until it returns.
+            typedef std::function<void(std::wstring_view)> Reader;
+
+            Backend() noexcept : own_seq(0), dropped(0) {}
+            virtual ~Backend() = default;
+
+            ///@return Number of changes made by own writes, that were dropped.
+            uint64_t dropped_count() const noexcept {
+                return this->dropped.load(std::memory_order_relaxed);
+            }
+
+            ///@return Current text or empty string if there is none.
+            virtual std::wstring get() = 0;
+            ///Passes current text to reader, without copying it if backend can view it in place.
+            ///
+            ///Text is empty if there is none.
+            virtual void read(const Reader& reader) {
+                reader(this->get());
+            }
+            ///Puts text onto clipboard, copying it straight into memory of clipboard.
+            ///
+            ///@retval true On success.
+            ///@retval false Otherwise.
+            virtual bool set(std::wstring_view text) = 0;
+            ///Calls callback on every change, until stopped.
+            ///
+            ///@throws runtime_error When changes cannot be tracked.
+            virtual void run(const Callback& callback) = 0;
+            ///Makes `run` return. Can be called from any thread, including callback.
+            virtual void stop() = 0;
+    };
+
+    /**
+     * Clipboard in memory of process.
+     *
+     * Other thread plays role of application, that copies text, while `run` reports changes as Windows does,
+     * including the ones made by `set`. Changes made before `run` are reported as well.
+     * Sequence number is the number of changes.
+     */
+    class Simulated : public Backend {
+        private:
+            mutable std::mutex lock;
+            std::condition_variable changed;
+            std::wstring text;
+            uint64_t changes;
+            bool is_stopped;
+
+            void put(std::wstring&& text);
+
+        public:
+            Simulated();
+
+            ///Copies text as other application would.
+            void copy(std::wstring text);
+            ///@return Number of changes so far, including own ones.
+            uint64_t change_count() const;
+
+            std::wstring get() override;
+            bool set(std::wstring_view text) override;
+            void run(const Callback& callback) override;
+            void stop() override;
+    };
+
+#ifdef _WIN32
+    /**
+     * Windows clipboard.
+     *
+     * Changes are received by message-only window, which listens for `WM_CLIPBOARDUPDATE`.
+     *
+     * Text is read in place, while clipboard is held open, so that reader should not take long.
+     */
+    class Win32 : public Backend {
+        private:
+            ///Thread, that runs message loop, 0 if it is not started.
+            std::atomic<unsigned long> thread;
+            std::atomic<bool> is_stopped;
+
+        public:
+            Win32();
+
+            std::wstring get() override;
+            void read(const Reader& reader) override;
+            bool set(std::wstring_view text) override;
+            void run(const Callback& callback) override;
+            void stop() override;
+    };
+#else
+    /**
+     * Clipboard driven by named pipe.
+     *
+     * Each line written into pipe, in UTF-8, is copied text. Text, that is set, is written
+     * into output as line, so that whole loop can be driven and checked by scripts.
+     */
+    class Fifo : public Backend {
+        private:
+            std::string path;
+            int input;
+            int output;
+            ///Pipe, that wakes `run` on stop.
+            int wake[2];
+            ///Guards text, which can be taken by other thread, than one of `run`.
+            std::mutex lock;
+            std::wstring text;
+
+        public:
+            ///Opens named pipe, creating it if there is none.
+            ///
+            ///@param output Descriptor to write set text into, stdout by default. Not closed.
+            ///@throws runtime_error When pipe cannot be opened.
+            explicit Fifo(const std::string& path, int output = 1);
+            ///Closes pipe, leaving it on file system.
+            ~Fifo();
+
+            Fifo(const Fifo&) = delete;
+            Fifo& operator=(const Fifo&) = delete;
+
+            std::wstring get() override;
+            bool set(std::wstring_view text) override;
+            void run(const Callback& callback) override;
+            void stop() override;
+    };
+#endif
+}
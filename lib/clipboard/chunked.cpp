@@ -0,0 +1,93 @@
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "chunked.hpp"
+
+using namespace clipboard;
+
+///Lowers priority of calling thread, so that it yields to cleaning of ordinary text.
+static void lower_priority() {
+#ifdef _WIN32
+    (void)SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    //Nice value belongs to thread on Linux.
+    (void)setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#endif
+}
+
+Chunked::Chunked(const text::Cleaner& cleaner, Sink&& sink) : cleaner(cleaner), sink(std::move(sink)), generation(0), cleaned(0), cancelled(0) {
+    this->worker = std::thread([this]() {
+        lower_priority();
+
+        std::wstring result;
+        while (auto item = this->mailbox.take()) {
+            this->cancellation.reset();
+
+            if (!this->clean(*item, result)) {
+                this->cancelled.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            this->cleaned.fetch_add(1, std::memory_order_relaxed);
+            if (result.size() != item->text.size() || result != item->text) this->sink(result);
+        }
+    });
+}
+
+Chunked::~Chunked() {
+    this->cancellation.cancel();
+    this->mailbox.close();
+    this->worker.join();
+}
+
+bool Chunked::clean(const Item& item, std::wstring& result) const {
+    const std::wstring_view text = item.text;
+    result.clear();
+    result.reserve(text.size());
+
+    std::wstring line;
+    for (size_t start = 0; start <= text.size();) {
+        //Cancel can come before worker resets token, so newer generation is checked as well.
+        if (this->cancellation.is_cancelled() || item.generation != this->generation.load()) return false;
+
+        auto end = text.find(L'\n', start);
+        if (end == std::wstring_view::npos) end = text.size();
+        //Trailing `\r` of CRLF is not seen by rules, but kept as line end.
+        const bool is_crlf = end > start && text[end - 1] == L'\r';
+
+        line.assign(text.substr(start, end - start - (is_crlf ? 1 : 0)));
+        const auto cleaned_line = this->cleaner.clean(line, this->cancellation);
+        if (this->cancellation.is_cancelled()) return false;
+        result.append(cleaned_line.has_value() ? *cleaned_line : line);
+        if (is_crlf) result.push_back(L'\r');
+
+        if (end == text.size()) break;
+        result.push_back(L'\n');
+        start = end + 1;
+    }
+
+    return item.generation == this->generation.load();
+}
+
+void Chunked::submit(std::wstring text) {
+    //Cancelled before posting, so that worker, which takes this text, resets token after cancellation.
+    const auto generation = this->generation.fetch_add(1) + 1;
+    this->cancellation.cancel();
+    this->mailbox.post(Item{generation, std::move(text)});
+}
+
+void Chunked::cancel() {
+    this->generation.fetch_add(1);
+    this->cancellation.cancel();
+}
+
+Chunked::Stats Chunked::stats() const noexcept {
+    return Stats{
+        this->cleaned.load(std::memory_order_relaxed),
+        this->cancelled.load(std::memory_order_relaxed),
+    };
+}
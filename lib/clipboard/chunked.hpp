@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <text/regex.hpp>
+#include <text/text.hpp>
+
+#include "mailbox.hpp"
+
+namespace clipboard {
+    /**
+     * Cleans oversized clipboard text line by line on own worker of lower priority.
+     *
+     * Regexes never run over whole text, and changes of ordinary size, which are cleaned
+     * elsewhere, do not wait for it. Newer text or cancel aborts text in progress.
+     */
+    class Chunked {
+        public:
+            ///Called by worker with cleaned text, if it is changed.
+            typedef std::function<void(std::wstring_view)> Sink;
+
+            struct Stats {
+                ///Texts cleaned till the end.
+                uint64_t cleaned;
+                ///Texts aborted by newer text or cancel.
+                uint64_t cancelled;
+            };
+
+        private:
+            struct Item {
+                uint64_t generation;
+                std::wstring text;
+            };
+
+            const text::Cleaner& cleaner;
+            Sink sink;
+            Mailbox<Item> mailbox;
+            text::Cancellation cancellation;
+            ///Generation of the latest text, which is the only one worth finishing.
+            std::atomic<uint64_t> generation;
+            std::atomic<uint64_t> cleaned;
+            std::atomic<uint64_t> cancelled;
+            std::thread worker;
+
+            ///@return False if aborted.
+            bool clean(const Item& item, std::wstring& result) const;
+
+        public:
+            ///Starts worker. Cleaner must outlive it.
+            Chunked(const text::Cleaner& cleaner, Sink&& sink);
+            ///Stops worker, aborting text in progress.
+            ~Chunked();
+
+            Chunked(const Chunked&) = delete;
+            Chunked& operator=(const Chunked&) = delete;
+
+            ///Passes text to worker, aborting one in progress.
+            void submit(std::wstring text);
+            ///Aborts text in progress, e.g. once clipboard has newer text of ordinary size.
+            void cancel();
+            Stats stats() const noexcept;
+    };
+}
@@ -1,3 +1,4 @@
+#ifdef _WIN32
 #include "clipboard.hpp"
 
 #if (_MSC_VER)
@@ -88,15 +89,50 @@ std::wstring Clipboard::get_wstring() const {
     }
 }
 
+ClipboardView::ClipboardView(const Clipboard& clipboard) : handle(NULL), data(NULL), length(0) {
+    //Size is checked first, so that text is never read past memory of Clipboard.
+    const size_t size = clipboard.size(CF_UNICODETEXT);
+    if (size < sizeof(wchar_t)) return;
+
+    const HANDLE clipboard_data = GetClipboardData(CF_UNICODETEXT);
+    if (clipboard_data == NULL) return;
+
+    const wchar_t *clipboard_mem = reinterpret_cast<const wchar_t*>(GlobalLock(clipboard_data));
+    if (clipboard_mem == NULL) return;
+
+    this->handle = clipboard_data;
+    this->data = clipboard_mem;
+    this->length = wcsnlen(clipboard_mem, size / sizeof(wchar_t));
+}
+
+ClipboardView::~ClipboardView() {
+    if (this->handle != NULL) (void)GlobalUnlock(this->handle);
+}
+
+std::wstring_view ClipboardView::text() const noexcept {
+    return std::wstring_view(this->data, this->length);
+}
+
 bool Clipboard::set(unsigned int format, const char* buf, size_t len) const {
-    const UINT alloc_flags = GHND;
+    return this->set(format, len, [buf, len](char* alloc_mem) {
+        (void)memcpy(alloc_mem, buf, len);
+    });
+}
+
+bool Clipboard::set(unsigned int format, size_t len, const std::function<void(char*)>& fill) const {
+    //Memory is written whole by fill, so it is not zeroed beforehand.
+    const UINT alloc_flags = GMEM_MOVEABLE;
     const HGLOBAL alloc_handle = GlobalAlloc(alloc_flags, len);
 
     if (alloc_handle == NULL) return false;
 
     char *alloc_mem = (char*)GlobalLock(alloc_handle);
+    if (alloc_mem == NULL) {
+        (void)GlobalFree(alloc_handle);
+        return false;
+    }
 
-    (void)memcpy(alloc_mem, buf, len);
+    fill(alloc_mem);
     (void)GlobalUnlock(alloc_handle);
     (void)this->empty();
 
@@ -130,6 +166,15 @@ bool Clipboard::set_string(const std::wstring& text) const {
     return this->set(CF_UNICODETEXT, reinterpret_cast<const char*>(text.c_str()), text_len);
 }
 
+bool Clipboard::set_string(std::wstring_view text) const {
+    const size_t text_len = (text.size() + 1) * sizeof(wchar_t);
+    return this->set(CF_UNICODETEXT, text_len, [text](char* alloc_mem) {
+        wchar_t* mem = reinterpret_cast<wchar_t*>(alloc_mem);
+        (void)wmemcpy(mem, text.data(), text.size());
+        mem[text.size()] = L'\0';
+    });
+}
+
 bool Clipboard::is_format_avail(unsigned int format) {
     return IsClipboardFormatAvailable(format) != 0;
 }
@@ -219,42 +264,4 @@ std::wstring Clipboard::get_format_name(unsigned long format) {
     Clipboard::get_format_name(format, buffer, sizeof(buffer) / sizeof(buffer[0]));
     return std::wstring(buffer);
 }
-
-#include <iostream>
-
-ClipboardMaster::ClipboardMaster(cb_t cb) noexcept : cb(cb) {}
-
-void ClipboardMaster::run() {
-    const auto window = CreateWindowExW(0, L"STATIC", NULL , 0,
-                                        CW_USEDEFAULT, CW_USEDEFAULT,
-                                        CW_USEDEFAULT, CW_USEDEFAULT,
-                                        HWND_MESSAGE, NULL, NULL, NULL);
-
-    if (window == nullptr) {
-        std::cerr << "Failed to create clipboard window. Error: " << GetLastError() << "\n";
-        exit(1);
-    }
-
-    if (!AddClipboardFormatListener(window)) {
-        std::cerr << "Cannot listen for clipboard updates. Error: " << GetLastError() << "\n";
-        exit(1);
-    }
-
-    MSG msg;
-    BOOL result;
-    while ((result = GetMessage(&msg, window, 797, 797)) != 0) {
-        if (result == -1)
-        {
-            std::cerr << "Unexpected error when handling clipboard message. Error: " << GetLastError() << "\n";
-        }
-        else
-        {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-            this->cb();
-        }
-    }
-
-    (void)RemoveClipboardFormatListener(window);
-    (void)DestroyWindow(window);
-}
+#endif
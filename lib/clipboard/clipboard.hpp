@@ -5,7 +5,9 @@
 #pragma warning(disable: 4577)
 #pragma warning(disable: 4530)
 #endif
+#include <functional>
 #include <string>
+#include <string_view>
 #if (_MSC_VER)
 #pragma warning(pop)
 #endif
@@ -154,6 +156,15 @@ class Clipboard {
         ///@retval false Otherwise.
         bool set(unsigned int format, const char* buf, size_t len) const;
 
+        ///Sets data onto Clipboard, which is written in place.
+        ///
+        ///@param[in] format Format to set onto.
+        ///@param[in] len Size of data.
+        ///@param[in] fill Writes all `len` bytes into memory of Clipboard, which is not initialized.
+        ///@retval true On success.
+        ///@retval false Otherwise.
+        bool set(unsigned int format, size_t len, const std::function<void(char*)>& fill) const;
+
         ///Sets string onto Clipboard.
         ///
         ///@param[in] text String to set.
@@ -194,6 +205,16 @@ class Clipboard {
         ///@retval false Otherwise.
         bool set_string(const std::wstring& text) const;
 
+        ///Sets wide string onto Clipboard, copying it straight into memory of Clipboard.
+        ///
+        ///@param[in] text String to set. Null terminator is appended.
+        ///
+        ///@note It uses `CF_UNICODETEXT`.
+        ///
+        ///@retval true On success.
+        ///@retval false Otherwise.
+        bool set_string(std::wstring_view text) const;
+
         ///Determines whether format is available on Clipboard.
         ///@retval true Format is available.
         ///@retval false Otherwise.
@@ -234,17 +255,42 @@ class Clipboard {
 
 };
 
-#include <functional>
 /**
- * Provides tracker of Clipboard changes.
- */
-class ClipboardMaster {
-    typedef std::function<void()> cb_t;
+ * Unicode text on Clipboard, viewed in place.
+ *
+ * Memory of Clipboard stays locked for lifetime of view, so text is not copied.
+ * View is bounded by size of Clipboard memory, even if text lacks terminating null.
+ *
+ * ~~~~~~~~~~~~~~~{.c}
+    #include "clipboard.hpp"
 
+    const Clipboard clip;
+    const ClipboardView view(clip);
+
+    if (view.text().size() > 0) {
+        std::wcout << L"Content of clipboard=" << view.text() << std::endl;
+    }
+ * ~~~~~~~~~~~~~~~
+ */
+class ClipboardView {
     private:
-        cb_t cb;
+        void* handle;
+        const wchar_t* data;
+        size_t length;
 
     public:
-        ClipboardMaster(cb_t) noexcept;
-        void run();
+        ///Locks `CF_UNICODETEXT` content.
+        ///
+        ///@param clipboard Opened Clipboard, which must outlive view.
+        explicit ClipboardView(const Clipboard& clipboard);
+
+        ///Unlocks memory.
+        ~ClipboardView();
+
+        ///@return Text without terminating null. Empty if nothing is available.
+        std::wstring_view text() const noexcept;
+
+        private:
+            ClipboardView (const ClipboardView&) = delete;
+            ClipboardView& operator= (const ClipboardView&) = delete;
 };
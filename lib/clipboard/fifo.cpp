@@ -0,0 +1,117 @@
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <text/text.hpp>
+
+#include "backend.hpp"
+
+using namespace clipboard;
+
+static std::runtime_error system_error(const std::string& message) {
+    return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+Fifo::Fifo(const std::string& path, int output) : path(path), input(-1), output(output), wake{-1, -1} {
+    if (mkfifo(path.c_str(), 0600) == -1 && errno != EEXIST) throw system_error("Cannot create pipe " + path);
+
+    //Opened for writing as well, so that there is no end of input, when writers come and go.
+    this->input = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (this->input == -1) throw system_error("Cannot open pipe " + path);
+
+    struct stat info;
+    if (fstat(this->input, &info) == -1 || !S_ISFIFO(info.st_mode)) {
+        close(this->input);
+        throw std::runtime_error("Not a named pipe: " + path);
+    }
+
+    if (pipe(this->wake) == -1) {
+        const auto error = system_error("Cannot create pipe");
+        close(this->input);
+        throw error;
+    }
+}
+
+Fifo::~Fifo() {
+    close(this->wake[0]);
+    close(this->wake[1]);
+    close(this->input);
+}
+
+std::wstring Fifo::get() {
+    const std::lock_guard<std::mutex> guard(this->lock);
+    return this->text;
+}
+
+bool Fifo::set(std::wstring_view text) {
+    std::string line;
+    try {
+        line = text::to_utf8_string(text);
+    }
+    catch (const std::range_error&) {
+        return false;
+    }
+    line.push_back('\n');
+
+    for (size_t written = 0; written < line.size();) {
+        const ssize_t count = write(this->output, line.data() + written, line.size() - written);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+void Fifo::run(const Callback& callback) {
+    pollfd handles[2] = {{this->input, POLLIN, 0}, {this->wake[0], POLLIN, 0}};
+    std::string pending;
+    char buffer[64 * 1024];
+
+    for (;;) {
+        if (poll(handles, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            throw system_error("Failed to wait for pipe");
+        }
+        if (handles[1].revents != 0) return;
+
+        const ssize_t count = ::read(this->input, buffer, sizeof(buffer));
+        if (count == -1) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            throw system_error("Failed to read pipe");
+        }
+        pending.append(buffer, static_cast<size_t>(count));
+
+        size_t start = 0;
+        for (size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start)) {
+            std::string_view line(pending.data() + start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+            try {
+                auto text = text::to_wide_string(line);
+                const std::lock_guard<std::mutex> guard(this->lock);
+                this->text = std::move(text);
+            }
+            catch (const std::range_error&) {
+                //Application would not copy broken text.
+                continue;
+            }
+            callback();
+        }
+        pending.erase(0, start);
+    }
+}
+
+void Fifo::stop() {
+    const char value = 1;
+    [[maybe_unused]] const auto result = write(this->wake[1], &value, sizeof(value));
+}
+#endif
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "latency.hpp"
+
+using namespace clipboard;
+
+///@return Index of the highest set bit of non-zero value.
+static inline unsigned highest_bit(uint64_t value) noexcept {
+#if defined(__GNUC__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned result = 0;
+    while (value >>= 1) result++;
+    return result;
+#endif
+}
+
+Histogram::Histogram() noexcept : count(0), max(0) {
+    for (auto& bucket : this->buckets) bucket.store(0, std::memory_order_relaxed);
+}
+
+size_t Histogram::index(uint64_t value) noexcept {
+    if (value < SUB_BUCKETS) return static_cast<size_t>(value);
+
+    //Top 5 bits of value select sub-bucket within its power of two.
+    const unsigned shift = highest_bit(value) - 5;
+    return SUB_BUCKETS + shift * SUB_BUCKETS + static_cast<size_t>((value >> shift) - SUB_BUCKETS);
+}
+
+uint64_t Histogram::highest(size_t index) noexcept {
+    if (index < SUB_BUCKETS) return index;
+
+    const auto shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+    const auto sub = (index - SUB_BUCKETS) % SUB_BUCKETS;
+    const uint64_t lowest = static_cast<uint64_t>(SUB_BUCKETS + sub) << shift;
+    return lowest + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::record(uint64_t value) noexcept {
+    this->buckets[Histogram::index(value)].fetch_add(1, std::memory_order_relaxed);
+    this->count.fetch_add(1, std::memory_order_relaxed);
+
+    auto max = this->max.load(std::memory_order_relaxed);
+    while (value > max && !this->max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+void Histogram::record(std::chrono::steady_clock::duration duration) noexcept {
+    const auto value = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    this->record(value > 0 ? static_cast<uint64_t>(value) : 0);
+}
+
+uint64_t Histogram::percentile(double rank) const noexcept {
+    const auto count = this->count.load(std::memory_order_relaxed);
+    if (count == 0) return 0;
+
+    const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(rank * static_cast<double>(count))));
+    const auto max = this->max.load(std::memory_order_relaxed);
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < BUCKETS; idx++) {
+        seen += this->buckets[idx].load(std::memory_order_relaxed);
+        if (seen >= target) return std::min(Histogram::highest(idx), max);
+    }
+    return max;
+}
+
+Histogram::Summary Histogram::summary() const noexcept {
+    return Summary{
+        this->count.load(std::memory_order_relaxed),
+        this->percentile(0.5),
+        this->percentile(0.9),
+        this->percentile(0.99),
+        this->max.load(std::memory_order_relaxed),
+    };
+}
+
+static void dump_stage(std::ostream& out, const char* name, const Histogram& histogram) {
+    const auto summary = histogram.summary();
+    const auto micros = [](uint64_t nanos) {
+        return static_cast<double>(nanos) / 1000.0;
+    };
+
+    out << std::left << std::setw(6) << name << std::right << " count " << summary.count;
+    if (summary.count > 0) {
+        out << std::fixed << std::setprecision(1)
+            << ", p50 " << micros(summary.p50) << "us, p90 " << micros(summary.p90)
+            << "us, p99 " << micros(summary.p99) << "us, max " << micros(summary.max) << "us";
+        out.unsetf(std::ios_base::floatfield);
+    }
+    out << "\n";
+}
+
+void Latency::dump(std::ostream& out) const {
+    dump_stage(out, "queue", this->queue);
+    dump_stage(out, "read", this->read);
+    dump_stage(out, "clean", this->clean);
+    dump_stage(out, "write", this->write);
+    dump_stage(out, "total", this->total);
+}
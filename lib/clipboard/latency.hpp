@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace clipboard {
+    /**
+     * Histogram of durations, in nanoseconds, with bounded relative error as HDR histogram.
+     *
+     * Each power of two is split into `SUB_BUCKETS` buckets, so that recorded value is off by
+     * at most 1/32 of itself. Recording is a few relaxed atomic increments, so that it can be
+     * done from any thread on hot path.
+     */
+    class Histogram {
+        public:
+            static constexpr size_t SUB_BUCKETS = 32;
+            static constexpr size_t BUCKETS = SUB_BUCKETS + (64 - 5) * SUB_BUCKETS;
+
+            struct Summary {
+                uint64_t count;
+                uint64_t p50;
+                uint64_t p90;
+                uint64_t p99;
+                uint64_t max;
+            };
+
+        private:
+            std::array<std::atomic<uint64_t>, BUCKETS> buckets;
+            std::atomic<uint64_t> count;
+            std::atomic<uint64_t> max;
+
+        public:
+            Histogram() noexcept;
+
+            Histogram(const Histogram&) = delete;
+            Histogram& operator=(const Histogram&) = delete;
+
+            ///@return Bucket of value.
+            static size_t index(uint64_t value) noexcept;
+            ///@return The highest value, that falls into bucket.
+            static uint64_t highest(size_t index) noexcept;
+
+            void record(uint64_t value) noexcept;
+            void record(std::chrono::steady_clock::duration duration) noexcept;
+            ///@return Value, that is not less than given share of recorded ones, e.g. 0.99.
+            uint64_t percentile(double rank) const noexcept;
+            Summary summary() const noexcept;
+    };
+
+    ///Stages of clipboard change from notification till cleaned text is written back.
+    struct Latency {
+        ///From change till its clean starts, including debounce.
+        Histogram queue;
+        ///Opening clipboard and viewing its text.
+        Histogram read;
+        Histogram clean;
+        ///Single attempt to set clipboard.
+        Histogram write;
+        ///From change till cleaned text is on clipboard.
+        Histogram total;
+
+        ///Writes summary of every stage, one per line.
+        void dump(std::ostream& out) const;
+    };
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace clipboard {
+    /**
+     * Single slot, where newer value replaces the one, that is not taken yet.
+     *
+     * Suits events, that only matter as the latest one, like clipboard changes.
+     */
+    template<typename T>
+    class Mailbox {
+        private:
+            mutable std::mutex lock;
+            std::condition_variable posted;
+            std::optional<T> slot;
+            uint64_t replaced;
+            bool is_closed;
+
+        public:
+            Mailbox() : replaced(0), is_closed(false) {}
+
+            Mailbox(const Mailbox&) = delete;
+            Mailbox& operator=(const Mailbox&) = delete;
+
+            ///Puts value, replacing one, that is not taken yet. Never waits for consumer.
+            void post(T value) {
+                this->post(std::move(value), []() {});
+            }
+
+            ///Same as above.
+            ///
+            ///@param on_post Called under lock before value is put, so that it is ordered with `on_take` of `take`.
+            template<typename F>
+            void post(T value, F&& on_post) {
+                {
+                    const std::lock_guard<std::mutex> guard(this->lock);
+                    on_post();
+                    if (this->slot.has_value()) this->replaced += 1;
+                    this->slot = std::move(value);
+                }
+                this->posted.notify_one();
+            }
+
+            ///Waits for value.
+            ///
+            ///@param debounce Once there is value, waits for newer one as long as they come within this time.
+            ///@return None once closed.
+            std::optional<T> take(std::chrono::steady_clock::duration debounce = std::chrono::steady_clock::duration::zero()) {
+                return this->take(debounce, []() {});
+            }
+
+            ///Same as above.
+            ///
+            ///@param on_take Called under lock once value is taken, so that `on_post` of newer value comes after it.
+            template<typename F>
+            std::optional<T> take(std::chrono::steady_clock::duration debounce, F&& on_take) {
+                std::unique_lock<std::mutex> guard(this->lock);
+                this->posted.wait(guard, [this]() {
+                    return this->slot.has_value() || this->is_closed;
+                });
+
+                while (debounce > debounce.zero() && !this->is_closed) {
+                    //Newer value takes place of the current one, so it is seen as replaced.
+                    const uint64_t replaced = this->replaced;
+                    if (!this->posted.wait_for(guard, debounce, [this, replaced]() {
+                        return this->replaced != replaced || this->is_closed;
+                    })) break;
+                }
+                if (this->is_closed) return std::nullopt;
+
+                std::optional<T> result;
+                result.swap(this->slot);
+                on_take();
+                return result;
+            }
+
+            ///@return Whether there is value, that is not taken yet.
+            bool has_value() const {
+                const std::lock_guard<std::mutex> guard(this->lock);
+                return this->slot.has_value();
+            }
+
+            ///@return Number of values, that were replaced before taken.
+            uint64_t replaced_count() const {
+                const std::lock_guard<std::mutex> guard(this->lock);
+                return this->replaced;
+            }
+
+            ///Makes `take` return none, dropping value, that is not taken.
+            void close() {
+                {
+                    const std::lock_guard<std::mutex> guard(this->lock);
+                    this->is_closed = true;
+                }
+                this->posted.notify_all();
+            }
+    };
+}
@@ -0,0 +1,44 @@
+#include "repeats.hpp"
+
+using namespace clipboard;
+
+Repeats::Repeats() noexcept : input{0, 0}, output{0, 0}, has_last(false), skipped(0) {
+}
+
+uint64_t Repeats::hash(std::wstring_view text) noexcept {
+    uint64_t result = 14695981039346656037ULL;
+    for (const auto ch : text) {
+        result ^= static_cast<uint64_t>(ch);
+        result *= 1099511628211ULL;
+    }
+    return result;
+}
+
+Repeats::Kind Repeats::find(std::wstring_view text) noexcept {
+    if (!this->has_last) return Kind::None;
+
+    const auto length = text.size();
+    if (length != this->input.length && length != this->output.length) return Kind::None;
+
+    const auto hash = Repeats::hash(text);
+    auto kind = Kind::None;
+    if (length == this->output.length && hash == this->output.hash) kind = Kind::Output;
+    else if (length == this->input.length && hash == this->input.hash) kind = Kind::Input;
+
+    if (kind != Kind::None) this->skipped.fetch_add(1, std::memory_order_relaxed);
+    return kind;
+}
+
+void Repeats::remember(std::wstring_view input, std::wstring_view output) noexcept {
+    this->input = Fingerprint{input.size(), Repeats::hash(input)};
+    this->output = input.data() == output.data() && input.size() == output.size() ? this->input : Fingerprint{output.size(), Repeats::hash(output)};
+    this->has_last = true;
+}
+
+void Repeats::forget() noexcept {
+    this->has_last = false;
+}
+
+uint64_t Repeats::skipped_count() const noexcept {
+    return this->skipped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace clipboard {
+    /**
+     * Recognizes clipboard text, that is the same as the last one cleaned.
+     *
+     * Applications often set the same text again, which needs no clean. Text is compared
+     * with the last input and output by length and 64-bit hash, so nothing is kept but them.
+     * Hash is computed only if length is the same as of either.
+     */
+    class Repeats {
+        public:
+            enum class Kind {
+                ///Text, that is not seen yet.
+                None,
+                ///The same text as the last input, which is cleaned into the same output.
+                Input,
+                ///The same text as the last output, which is already clean.
+                Output,
+            };
+
+        private:
+            struct Fingerprint {
+                size_t length;
+                uint64_t hash;
+            };
+
+            Fingerprint input;
+            Fingerprint output;
+            bool has_last;
+            std::atomic<uint64_t> skipped;
+
+        public:
+            Repeats() noexcept;
+
+            ///@return 64-bit FNV-1a hash of text.
+            static uint64_t hash(std::wstring_view text) noexcept;
+
+            ///Finds whether text is repeated, counting it as skip if so.
+            Kind find(std::wstring_view text) noexcept;
+            ///Remembers finished clean.
+            ///
+            ///@param output Cleaned text, which is the same as input if clean changed nothing.
+            void remember(std::wstring_view input, std::wstring_view output) noexcept;
+            ///Forgets the last clean, e.g. when it is aborted.
+            void forget() noexcept;
+            ///@return Number of texts, which were recognized as repeated.
+            uint64_t skipped_count() const noexcept;
+    };
+}
@@ -0,0 +1,45 @@
+#include "scheduler.hpp"
+
+using namespace clipboard;
+
+Scheduler::Scheduler(Backend::Callback&& work, std::chrono::steady_clock::duration debounce) : debounce(debounce), work(std::move(work)) {
+    this->worker = std::thread([this]() {
+        //Token is reset under lock of mailbox, so that cancel of newer change is never lost.
+        const auto reset = [this]() {
+            this->cancellation.reset();
+        };
+        while (const auto change_time = this->mailbox.take(this->debounce, reset)) {
+            this->change_time = *change_time;
+            this->work();
+        }
+    });
+}
+
+Scheduler::~Scheduler() {
+    this->mailbox.close();
+    this->worker.join();
+}
+
+void Scheduler::notify() {
+    //Cancelled under lock of mailbox, so that it either precedes taking of this change,
+    //which resets token, or follows taking of current one, aborting its work.
+    this->mailbox.post(std::chrono::steady_clock::now(), [this]() {
+        this->cancellation.cancel();
+    });
+}
+
+bool Scheduler::is_stale() const {
+    return this->mailbox.has_value();
+}
+
+const text::Cancellation& Scheduler::token() const noexcept {
+    return this->cancellation;
+}
+
+std::chrono::steady_clock::time_point Scheduler::changed_at() const noexcept {
+    return this->change_time;
+}
+
+uint64_t Scheduler::dropped_count() const {
+    return this->mailbox.replaced_count();
+}
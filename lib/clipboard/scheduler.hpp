@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <text/regex.hpp>
+
+#include "backend.hpp"
+#include "mailbox.hpp"
+
+namespace clipboard {
+    /**
+     * Runs work of clipboard changes on own worker, so that bursts of changes are coalesced.
+     *
+     * Changes are passed through latest-wins mailbox: while work is running, only the newest
+     * change waits for it, and the others are dropped. With debounce, work waits until changes
+     * stop coming for given time.
+     *
+     * Newer change cancels work in progress through token, so that stale clean is aborted at once.
+     */
+    class Scheduler {
+        private:
+            ///Time of change.
+            Mailbox<std::chrono::steady_clock::time_point> mailbox;
+            text::Cancellation cancellation;
+            std::chrono::steady_clock::duration debounce;
+            Backend::Callback work;
+            ///Time of change, that current work is for.
+            std::chrono::steady_clock::time_point change_time;
+            std::thread worker;
+
+        public:
+            ///Starts worker.
+            Scheduler(Backend::Callback&& work, std::chrono::steady_clock::duration debounce = std::chrono::steady_clock::duration::zero());
+            ///Stops worker, dropping change, that waits for it.
+            ~Scheduler();
+
+            Scheduler(const Scheduler&) = delete;
+            Scheduler& operator=(const Scheduler&) = delete;
+
+            ///Passes change to worker. Never waits for it, so it can be called by clipboard listener.
+            void notify();
+            ///@return Whether there is newer change, so that result of current work is stale.
+            bool is_stale() const;
+            ///@return Token, that is cancelled once there is newer change, than one of current work.
+            const text::Cancellation& token() const noexcept;
+            ///@return Time of change, that current work is for. Valid only within work.
+            std::chrono::steady_clock::time_point changed_at() const noexcept;
+            ///@return Number of changes, that were replaced by newer ones before worker took them.
+            uint64_t dropped_count() const;
+    };
+}
@@ -0,0 +1,70 @@
+#include "backend.hpp"
+
+using namespace clipboard;
+
+Simulated::Simulated() : changes(0), is_stopped(false) {
+}
+
+void Simulated::put(std::wstring&& text) {
+    {
+        const std::lock_guard<std::mutex> guard(this->lock);
+        this->text = std::move(text);
+        this->changes += 1;
+    }
+    this->changed.notify_all();
+}
+
+void Simulated::copy(std::wstring text) {
+    this->put(std::move(text));
+}
+
+uint64_t Simulated::change_count() const {
+    const std::lock_guard<std::mutex> guard(this->lock);
+    return this->changes;
+}
+
+std::wstring Simulated::get() {
+    const std::lock_guard<std::mutex> guard(this->lock);
+    return this->text;
+}
+
+bool Simulated::set(std::wstring_view text) {
+    {
+        const std::lock_guard<std::mutex> guard(this->lock);
+        this->text.assign(text);
+        this->changes += 1;
+        this->own_seq.store(this->changes, std::memory_order_relaxed);
+    }
+    this->changed.notify_all();
+    return true;
+}
+
+void Simulated::run(const Callback& callback) {
+    uint64_t reported = 0;
+    std::unique_lock<std::mutex> guard(this->lock);
+
+    for (;;) {
+        this->changed.wait(guard, [this, reported]() {
+            return this->is_stopped || this->changes != reported;
+        });
+        if (this->is_stopped) return;
+
+        //Each change is reported on its own, like message of Windows.
+        reported += 1;
+        if (this->changes == this->own_seq.load(std::memory_order_relaxed)) {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        guard.unlock();
+        callback();
+        guard.lock();
+    }
+}
+
+void Simulated::stop() {
+    {
+        const std::lock_guard<std::mutex> guard(this->lock);
+        this->is_stopped = true;
+    }
+    this->changed.notify_all();
+}
@@ -0,0 +1,100 @@
+#ifdef _WIN32
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <windows.h>
+
+#include "backend.hpp"
+#include "clipboard.hpp"
+
+using namespace clipboard;
+
+Win32::Win32() : thread(0), is_stopped(false) {
+}
+
+std::wstring Win32::get() {
+    try {
+        const Clipboard clip;
+        return clip.get_wstring();
+    }
+    catch (const std::runtime_error&) {
+        //Other application holds clipboard.
+        return std::wstring();
+    }
+}
+
+void Win32::read(const Reader& reader) {
+    std::optional<Clipboard> clip;
+    try {
+        clip.emplace();
+    }
+    catch (const std::runtime_error&) {
+        //Other application holds clipboard.
+        reader(std::wstring_view());
+        return;
+    }
+
+    const ClipboardView view(*clip);
+    reader(view.text());
+}
+
+bool Win32::set(std::wstring_view text) {
+    try {
+        const Clipboard clip;
+        if (!clip.set_string(text)) return false;
+        this->own_seq.store(Clipboard::seq_num(), std::memory_order_relaxed);
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+void Win32::run(const Callback& callback) {
+    const auto window = CreateWindowExW(0, L"STATIC", NULL, 0,
+                                        CW_USEDEFAULT, CW_USEDEFAULT,
+                                        CW_USEDEFAULT, CW_USEDEFAULT,
+                                        HWND_MESSAGE, NULL, NULL, NULL);
+    if (window == nullptr) {
+        throw std::runtime_error("Failed to create clipboard window. Error: " + std::to_string(GetLastError()));
+    }
+
+    if (!AddClipboardFormatListener(window)) {
+        const auto error = GetLastError();
+        (void)DestroyWindow(window);
+        throw std::runtime_error("Cannot listen for clipboard updates. Error: " + std::to_string(error));
+    }
+
+    //Stop is delivered as WM_QUIT to this thread.
+    this->thread.store(GetCurrentThreadId());
+    if (this->is_stopped.load()) PostQuitMessage(0);
+
+    MSG msg;
+    BOOL result;
+    while ((result = GetMessageW(&msg, NULL, 0, 0)) != 0) {
+        if (result == -1) break;
+
+        TranslateMessage(&msg);
+        DispatchMessageW(&msg);
+        if (msg.hwnd != window || msg.message != WM_CLIPBOARDUPDATE) continue;
+
+        //Own write is recognized without opening clipboard.
+        if (Clipboard::seq_num() == this->own_seq.load(std::memory_order_relaxed)) {
+            this->dropped.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        callback();
+    }
+
+    this->thread.store(0);
+    (void)RemoveClipboardFormatListener(window);
+    (void)DestroyWindow(window);
+}
+
+void Win32::stop() {
+    this->is_stopped.store(true);
+    const auto thread = this->thread.load();
+    if (thread != 0) (void)PostThreadMessageW(thread, WM_QUIT, 0, 0);
+}
+#endif
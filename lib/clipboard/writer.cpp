@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "writer.hpp"
+
+using namespace clipboard;
+
+Writer::Writer(Backend& backend, const WriterOptions& options) : backend(backend), options(options), has_pending(false), is_stopped(false), written(0), retries(0), superseded(0), failed(0) {
+    if (this->options.max_attempts == 0) this->options.max_attempts = 1;
+
+    this->thread = std::thread([this]() {
+        this->run();
+    });
+}
+
+Writer::~Writer() {
+    {
+        const std::lock_guard<std::mutex> guard(this->lock);
+        this->is_stopped = true;
+    }
+    this->posted.notify_all();
+    this->thread.join();
+}
+
+void Writer::write(std::wstring_view text, std::chrono::steady_clock::time_point since) {
+    if (since == std::chrono::steady_clock::time_point()) since = std::chrono::steady_clock::now();
+    {
+        const std::lock_guard<std::mutex> guard(this->lock);
+        this->pending.assign(text);
+        this->pending_since = since;
+        this->has_pending = true;
+    }
+    this->posted.notify_one();
+}
+
+bool Writer::backoff(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> guard(this->lock);
+    const auto is_interrupted = this->posted.wait_for(guard, delay, [this]() {
+        return this->has_pending || this->is_stopped;
+    });
+    if (!is_interrupted) return true;
+
+    if (this->has_pending) this->superseded.fetch_add(1, std::memory_order_relaxed);
+    else this->failed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Writer::run() {
+    //Swapped with pending one, so that both keep their capacity.
+    std::wstring text;
+    std::chrono::steady_clock::time_point since;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->posted.wait(guard, [this]() {
+                return this->has_pending || this->is_stopped;
+            });
+            //Pending text is still attempted once on stop, so that last write is not lost.
+            if (!this->has_pending) return;
+
+            text.swap(this->pending);
+            since = this->pending_since;
+            this->has_pending = false;
+        }
+
+        //Time spent in queue and clean counts too, so that stale text is not retried for long.
+        const auto deadline = since + this->options.deadline;
+        auto delay = this->options.first_delay;
+        for (unsigned attempt = 1;; attempt++) {
+            const auto start = std::chrono::steady_clock::now();
+            const auto is_written = this->backend.set(text);
+            if (this->options.latency != nullptr) {
+                const auto end = std::chrono::steady_clock::now();
+                this->options.latency->write.record(end - start);
+                if (is_written) this->options.latency->total.record(end - since);
+            }
+
+            if (is_written) {
+                this->written.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+
+            if (attempt >= this->options.max_attempts || std::chrono::steady_clock::now() + delay > deadline) {
+                this->failed.fetch_add(1, std::memory_order_relaxed);
+                if (this->options.on_failure) this->options.on_failure(text);
+                break;
+            }
+
+            this->retries.fetch_add(1, std::memory_order_relaxed);
+            if (!this->backoff(delay)) break;
+            delay = std::min(delay * 2, this->options.max_delay);
+        }
+    }
+}
+
+Writer::Stats Writer::stats() const noexcept {
+    return Stats{
+        this->written.load(std::memory_order_relaxed),
+        this->retries.load(std::memory_order_relaxed),
+        this->superseded.load(std::memory_order_relaxed),
+        this->failed.load(std::memory_order_relaxed),
+    };
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "backend.hpp"
+#include "latency.hpp"
+
+namespace clipboard {
+    struct WriterOptions {
+        ///Attempts of single write, including the first one.
+        unsigned max_attempts = 8;
+        ///Delay after the first failure, which doubles after each next one.
+        std::chrono::milliseconds first_delay{1};
+        std::chrono::milliseconds max_delay{100};
+        ///Time since write is requested, after which it is given up.
+        std::chrono::milliseconds deadline{1000};
+        ///Called by writer's thread, when write is given up.
+        std::function<void(std::wstring_view)> on_failure;
+        ///Records each attempt into `write` and time since change till done write into `total`.
+        Latency* latency = nullptr;
+    };
+
+    /**
+     * Writes text onto clipboard from own thread, retrying while other application holds it.
+     *
+     * Retries back off exponentially and stop at attempt cap or deadline, so that contention
+     * neither spins nor blocks the one, who requests write. Newer text supersedes the one,
+     * that is still retried.
+     *
+     * Text is passed through two buffers, which are swapped, so that once they are grown
+     * writes allocate nothing and text is copied only into them and into clipboard.
+     */
+    class Writer {
+        public:
+            struct Stats {
+                uint64_t written;
+                ///Failed attempts, that were retried.
+                uint64_t retries;
+                ///Writes replaced by newer text before they succeeded.
+                uint64_t superseded;
+                ///Writes given up.
+                uint64_t failed;
+            };
+
+        private:
+            Backend& backend;
+            WriterOptions options;
+
+            std::mutex lock;
+            std::condition_variable posted;
+            ///Text, that waits for writer, if `has_pending`.
+            std::wstring pending;
+            ///Time of change, which pending text is cleaned from.
+            std::chrono::steady_clock::time_point pending_since;
+            bool has_pending;
+            bool is_stopped;
+
+            std::atomic<uint64_t> written;
+            std::atomic<uint64_t> retries;
+            std::atomic<uint64_t> superseded;
+            std::atomic<uint64_t> failed;
+            std::thread thread;
+
+            void run();
+            ///Sleeps before next attempt.
+            ///
+            ///@return false If there is newer text or writer is stopped, so that write is given up.
+            bool backoff(std::chrono::milliseconds delay);
+
+        public:
+            ///Starts writer. Backend must outlive it.
+            explicit Writer(Backend& backend, const WriterOptions& options = WriterOptions());
+            ///Stops writer, after last attempt to write pending text.
+            ~Writer();
+
+            Writer(const Writer&) = delete;
+            Writer& operator=(const Writer&) = delete;
+
+            ///Requests write, replacing text, that is not written yet. Never waits for clipboard.
+            ///
+            ///Text is copied, so it can be a view of temporary memory.
+            ///
+            ///@param since Time of change, which text is cleaned from, for latency and deadline. Time of call by default.
+            void write(std::wstring_view text, std::chrono::steady_clock::time_point since = std::chrono::steady_clock::time_point());
+            Stats stats() const noexcept;
+    };
+}
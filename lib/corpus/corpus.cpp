@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <text/stream.hpp>
+
+#include "corpus.hpp"
+#include "queue.hpp"
+
+using namespace corpus;
+
+///Size of single read, that is also approximate size of work item.
+static constexpr size_t BLOCK_SIZE = 1 << 20;
+///Number of queued blocks per worker.
+static constexpr size_t BLOCKS_PER_WORKER = 4;
+static constexpr size_t npos = static_cast<size_t>(-1);
+
+///Lines of input with its order.
+struct Block {
+    ///Sequence number of block, `npos` marks end of input.
+    size_t seq = npos;
+    ///Input owned by block, if it is not mapped into memory.
+    std::string data;
+    ///Input, that is mapped into memory.
+    std::string_view slice;
+    ///Number of lines in block.
+    uint64_t lines = 0;
+
+    std::string_view input() const noexcept {
+        return this->data.empty() ? this->slice : std::string_view(this->data);
+    }
+};
+
+///Appends cleaned line to result, or line as it is, if it cannot be converted.
+///
+///Trailing `\r` is not cleaned, but kept, so that CRLF line end stays as it was.
+static void clean_line(std::string_view line, const text::Cleaner& cleaner, std::string& result) {
+    const bool is_crlf = !line.empty() && line.back() == '\r';
+    const auto content = is_crlf ? line.substr(0, line.size() - 1) : line;
+
+    try {
+        const auto cleaned = cleaner.clean(text::to_wide_string(content));
+        if (cleaned.has_value()) {
+            result.append(text::to_utf8_string(*cleaned));
+            if (is_crlf) result.push_back('\r');
+            return;
+        }
+    }
+    catch (const std::range_error&) {
+    }
+
+    result.append(line);
+}
+
+///Cleans lines one by one, leaving lines, that cannot be converted, as they are.
+static std::string clean_lines(std::string_view block, const text::Cleaner& cleaner) {
+    std::string result;
+    result.reserve(block.size());
+
+    for (size_t start = 0; start < block.size();) {
+        size_t end = block.find('\n', start);
+        const bool terminated = end != std::string::npos;
+        if (!terminated) end = block.size();
+
+        clean_line(block.substr(start, end - start), cleaner, result);
+        if (terminated) result.push_back('\n');
+        start = end + 1;
+    }
+
+    return result;
+}
+
+static std::string clean_block(std::string_view block, const text::Cleaner& cleaner) {
+    std::wstring result;
+    text::StreamCleaner stream(cleaner, [&result](std::wstring_view line) {
+        result.append(line);
+        result.push_back(L'\n');
+    });
+
+    //Whole block is converted at once, as conversion is costly to set up.
+    try {
+        result.reserve(block.size());
+        stream.feed(text::to_wide_string(block));
+        if (stream.pending_size() > 0) {
+            stream.finish();
+            result.pop_back();
+        }
+
+        return text::to_utf8_string(result);
+    }
+    catch (const std::range_error&) {
+        return clean_lines(block, cleaner);
+    }
+}
+
+double Stats::throughput() const noexcept {
+    const double seconds = std::chrono::duration<double>(this->elapsed).count();
+    return seconds > 0 ? static_cast<double>(this->bytes_read) / (1024 * 1024) / seconds : 0;
+}
+
+///Runs pipeline over blocks provided by `read`, that returns false at the end of input.
+///
+///`idle` is called once writer has written everything it has got so far.
+static Stats run(const std::function<bool(Block&)>& read, const Sink& write, const std::function<void()>& idle, const text::Cleaner& cleaner, unsigned workers) {
+    if (workers == 0) workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+    const auto start = std::chrono::steady_clock::now();
+    Stats result{0, 0, 0, std::chrono::steady_clock::duration::zero()};
+    Queue<Block> cleaning(workers * BLOCKS_PER_WORKER);
+    Queue<Block> writing(workers * BLOCKS_PER_WORKER);
+
+    std::vector<std::thread> cleaners;
+    for (unsigned idx = 0; idx < workers; idx++) {
+        cleaners.emplace_back([&cleaning, &writing, &cleaner]() {
+            for (;;) {
+                Block block = cleaning.pop();
+                if (block.seq != npos) {
+                    const auto input = block.input();
+                    block.lines = static_cast<uint64_t>(std::count(input.begin(), input.end(), '\n'));
+                    if (input.back() != '\n') block.lines += 1;
+                    block.data = clean_block(input, cleaner);
+                }
+
+                const bool last = block.seq == npos;
+                writing.push(std::move(block));
+                if (last) return;
+            }
+        });
+    }
+
+    std::thread writer([&writing, &write, &idle, &result, workers]() {
+        //Blocks, that are done before preceding ones.
+        std::map<size_t, Block> pending;
+        size_t next = 0;
+        unsigned finished = 0;
+
+        while (finished < workers) {
+            Block block;
+            if (!writing.try_pop(block)) {
+                if (idle) idle();
+                block = writing.pop();
+            }
+
+            if (block.seq == npos) {
+                finished += 1;
+                continue;
+            }
+
+            pending.emplace(block.seq, std::move(block));
+            for (auto iter = pending.begin(); iter != pending.end() && iter->first == next; iter = pending.erase(iter)) {
+                write(iter->second.data);
+                result.bytes_written += iter->second.data.size();
+                result.lines += iter->second.lines;
+                next += 1;
+            }
+        }
+    });
+
+    size_t seq = 0;
+    //Failed read still has to stop pipeline.
+    std::exception_ptr error;
+    try {
+        for (;;) {
+            Block block;
+            if (!read(block)) break;
+
+            result.bytes_read += block.input().size();
+            block.seq = seq++;
+            cleaning.push(std::move(block));
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    for (unsigned idx = 0; idx < workers; idx++) {
+        cleaning.push(Block());
+    }
+
+    for (auto& thread : cleaners) {
+        thread.join();
+    }
+    writer.join();
+    if (error) std::rethrow_exception(error);
+
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+///Reads input by `read` until there is at least one complete line.
+///
+///@param carry Incomplete line of previous read.
+static bool read_lines(const std::function<size_t(char*, size_t)>& read, std::vector<char>& buffer, std::string& carry, Block& block) {
+    for (;;) {
+        const size_t count = read(buffer.data(), buffer.size());
+        if (count == 0) break;
+
+        const auto begin = buffer.begin();
+        const auto end = begin + static_cast<std::ptrdiff_t>(count);
+        const auto line_end = std::find(std::make_reverse_iterator(end), std::make_reverse_iterator(begin), '\n').base();
+        if (line_end == begin) {
+            //Line is longer than block.
+            carry.append(begin, end);
+            continue;
+        }
+
+        block.data = std::move(carry);
+        block.data.append(begin, line_end);
+        carry.assign(line_end, end);
+        return true;
+    }
+
+    if (carry.empty()) return false;
+
+    block.data = std::move(carry);
+    carry.clear();
+    return true;
+}
+
+Stats corpus::process(std::istream& input, std::ostream& output, const text::Cleaner& cleaner, unsigned workers) {
+    std::vector<char> buffer(BLOCK_SIZE);
+    std::string carry;
+
+    const auto read = [&input, &buffer, &carry](Block& block) {
+        return read_lines([&input](char* data, size_t size) {
+            input.read(data, static_cast<std::streamsize>(size));
+            return static_cast<size_t>(input.gcount());
+        }, buffer, carry, block);
+    };
+
+    const auto write = [&output](std::string_view data) {
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+    };
+
+    const auto result = run(read, write, nullptr, cleaner, workers);
+    output.flush();
+    return result;
+}
+
+Stats corpus::process(std::string_view input, const Sink& output, const text::Cleaner& cleaner, unsigned workers) {
+    const auto read = [&input](Block& block) {
+        if (input.empty()) return false;
+
+        //Block ends at the first line end after its nominal size.
+        size_t size = input.find('\n', std::min(BLOCK_SIZE, input.size()) - 1);
+        size = size == std::string_view::npos ? input.size() : size + 1;
+
+        block.slice = input.substr(0, size);
+        input.remove_prefix(size);
+        return true;
+    };
+
+    return run(read, output, nullptr, cleaner, workers);
+}
+
+Stats corpus::filter(InputFile& input, OutputFile& output, const text::Cleaner& cleaner, Buffering buffering, unsigned workers) {
+    std::vector<char> buffer(BLOCK_SIZE);
+    std::string carry;
+
+    //Read returns as soon as there is something, so interactive lines come one by one.
+    const auto read = [&input, &buffer, &carry](Block& block) {
+        return read_lines([&input](char* data, size_t size) {
+            return input.read(data, size);
+        }, buffer, carry, block);
+    };
+
+    const auto write = [&output, buffering](std::string_view data) {
+        output.write(data);
+        if (buffering == Buffering::Line) output.flush();
+    };
+
+    //Nothing else is coming soon, so don't keep reader of output waiting.
+    const auto idle = [&output]() {
+        output.flush();
+    };
+
+    const auto result = run(read, write, idle, cleaner, workers);
+    output.flush();
+    return result;
+}
+
+Stats corpus::follow(Follower& input, const Sink& output, const text::Cleaner& cleaner) {
+    const auto start = std::chrono::steady_clock::now();
+    Stats result{0, 0, 0, std::chrono::steady_clock::duration::zero()};
+
+    //Appended lines are few at a time, so there is nothing to gain from workers.
+    std::string lines;
+    while (input.next(lines)) {
+        const auto cleaned = clean_lines(lines, cleaner);
+        output(cleaned);
+
+        result.bytes_read += lines.size();
+        result.bytes_written += cleaned.size();
+        result.lines += static_cast<uint64_t>(std::count(lines.begin(), lines.end(), '\n'));
+    }
+
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
+
+Stats corpus::consume(RingConsumer& input, const Sink& output, const text::Cleaner& cleaner) {
+    const auto start = std::chrono::steady_clock::now();
+    Stats result{0, 0, 0, std::chrono::steady_clock::duration::zero()};
+
+    std::string cleaned;
+    std::string_view line;
+    while (input.next(line)) {
+        cleaned.clear();
+        //Line is decoded straight from its slot.
+        clean_line(line, cleaner, cleaned);
+        cleaned.push_back('\n');
+        output(cleaned);
+
+        result.bytes_read += line.size();
+        result.bytes_written += cleaned.size();
+        result.lines += 1;
+    }
+
+    result.elapsed = std::chrono::steady_clock::now() - start;
+    return result;
+}
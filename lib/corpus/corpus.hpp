@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <string_view>
+#include <istream>
+#include <ostream>
+
+#include <text/text.hpp>
+
+#include "file.hpp"
+#include "follow.hpp"
+#include "ring.hpp"
+
+namespace corpus {
+    struct Stats {
+        uint64_t bytes_read;
+        uint64_t bytes_written;
+        uint64_t lines;
+        std::chrono::steady_clock::duration elapsed;
+
+        ///@return Input processed per second, in MiB.
+        double throughput() const noexcept;
+    };
+
+    /**
+     * Cleans UTF-8 text line by line, the same way as `text::StreamCleaner`.
+     *
+     * Work is done by pipeline:
+     *
+     * - Reader splits input into big blocks of whole lines.
+     * - Workers clean blocks in parallel.
+     * - Writer puts cleaned blocks in original order.
+     *
+     * Stages are connected by bounded queues, so that memory stays constant regardless of input size.
+     * Lines, that are not valid UTF-8, are written as they are.
+     *
+     * @param workers Number of cleaning threads, 0 means number of cores.
+     */
+    Stats process(std::istream& input, std::ostream& output, const text::Cleaner& cleaner, unsigned workers = 0);
+
+    ///Receives cleaned output in order.
+    typedef std::function<void(std::string_view)> Sink;
+
+    /**
+     * Cleans text, that is already in memory, like mapped file.
+     *
+     * Blocks are cut directly from input without copying.
+     */
+    Stats process(std::string_view input, const Sink& output, const text::Cleaner& cleaner, unsigned workers = 0);
+
+    enum class Buffering {
+        ///Output is flushed after every line.
+        Line,
+        ///Output is flushed once buffer is full or there is no more input for now.
+        Block,
+    };
+
+    /**
+     * Cleans input, that may come slowly, like stdin.
+     *
+     * Lines are cleaned as soon as they are read, so interactive input is not delayed.
+     * Otherwise it is the same as `process`.
+     */
+    Stats filter(InputFile& input, OutputFile& output, const text::Cleaner& cleaner, Buffering buffering, unsigned workers = 0);
+
+    /**
+     * Cleans lines appended to followed file, until it is stopped.
+     *
+     * Lines are cleaned and passed to output as soon as they are noticed, in the calling thread.
+     */
+    Stats follow(Follower& input, const Sink& output, const text::Cleaner& cleaner);
+
+    /**
+     * Cleans lines passed by hook process through shared-memory ring, until it is closed.
+     *
+     * Each line is cleaned straight from its slot and written out with terminator.
+     */
+    Stats consume(RingConsumer& input, const Sink& output, const text::Cleaner& cleaner);
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <text/text.hpp>
+
+#include "file.hpp"
+
+using namespace corpus;
+
+///Writes smaller than that are accumulated.
+static constexpr size_t WRITE_SIZE = 4 * 1024 * 1024;
+
+#ifdef _WIN32
+///Reads file till its end.
+///
+///@return false If read fails.
+static bool read_whole(HANDLE file, std::string& result) {
+    char chunk[64 * 1024];
+    for (;;) {
+        DWORD count = 0;
+        //Writer of pipe has closed it.
+        if (!ReadFile(file, chunk, sizeof(chunk), &count, nullptr)) return GetLastError() == ERROR_BROKEN_PIPE;
+        if (count == 0) return true;
+        result.append(chunk, count);
+    }
+}
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0), mapping(nullptr) {
+    const auto wide_path = text::to_wide_string(path);
+    const HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open file: " + path);
+
+    //Pipe has no size to map, so it is read as stream.
+    if (GetFileType(file) != FILE_TYPE_DISK) {
+        const auto is_read = read_whole(file, this->buffer);
+        CloseHandle(file);
+        if (!is_read) throw std::runtime_error("Cannot read file: " + path);
+
+        this->data = this->buffer.data();
+        this->size = this->buffer.size();
+        return;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot get size of file: " + path);
+    }
+
+    //Empty file cannot be mapped.
+    if (file_size.QuadPart > 0) {
+        this->mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (this->mapping != nullptr) {
+            this->data = static_cast<const char*>(MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (this->data == nullptr) {
+            if (this->mapping != nullptr) CloseHandle(this->mapping);
+            CloseHandle(file);
+            throw std::runtime_error("Cannot map file: " + path);
+        }
+        this->size = static_cast<size_t>(file_size.QuadPart);
+    }
+
+    //Mapping keeps file open.
+    CloseHandle(file);
+}
+
+MappedFile::~MappedFile() {
+    if (this->mapping == nullptr) return;
+
+    UnmapViewOfFile(this->data);
+    CloseHandle(this->mapping);
+}
+
+bool corpus::is_same_file(const std::string& left, const std::string& right) {
+    //Identity of file is queried without access to its content.
+    const auto open = [](const std::string& path) {
+        const auto wide_path = text::to_wide_string(path);
+        return CreateFileW(wide_path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    };
+
+    const HANDLE left_file = open(left);
+    if (left_file == INVALID_HANDLE_VALUE) return false;
+    const HANDLE right_file = open(right);
+    if (right_file == INVALID_HANDLE_VALUE) {
+        CloseHandle(left_file);
+        return false;
+    }
+
+    BY_HANDLE_FILE_INFORMATION left_info;
+    BY_HANDLE_FILE_INFORMATION right_info;
+    const auto result = GetFileInformationByHandle(left_file, &left_info) && GetFileInformationByHandle(right_file, &right_info) &&
+                        left_info.dwVolumeSerialNumber == right_info.dwVolumeSerialNumber &&
+                        left_info.nFileIndexHigh == right_info.nFileIndexHigh &&
+                        left_info.nFileIndexLow == right_info.nFileIndexLow;
+
+    CloseHandle(left_file);
+    CloseHandle(right_file);
+    return result;
+}
+
+InputFile::InputFile(const std::string& path) : handle(nullptr), is_owned(!path.empty()) {
+    if (this->is_owned) {
+        const auto wide_path = text::to_wide_string(path);
+        this->handle = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (this->handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open file: " + path);
+    }
+    else {
+        this->handle = GetStdHandle(STD_INPUT_HANDLE);
+    }
+}
+
+InputFile::~InputFile() {
+    if (this->is_owned) CloseHandle(this->handle);
+}
+
+size_t InputFile::read(char* buffer, size_t size) {
+    DWORD count = 0;
+    if (!ReadFile(this->handle, buffer, static_cast<DWORD>(std::min<size_t>(size, 1u << 30)), &count, nullptr)) {
+        //Writer of pipe has closed it.
+        if (GetLastError() == ERROR_BROKEN_PIPE) return 0;
+        throw std::runtime_error("Failed to read input");
+    }
+    return count;
+}
+
+bool InputFile::is_interactive() const noexcept {
+    return GetFileType(this->handle) == FILE_TYPE_CHAR;
+}
+
+OutputFile::OutputFile(const std::string& path) : handle(nullptr), is_owned(!path.empty()), failed(false) {
+    if (this->is_owned) {
+        const auto wide_path = text::to_wide_string(path);
+        this->handle = CreateFileW(wide_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (this->handle == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open file: " + path);
+    }
+    else {
+        this->handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+    this->buffer.reserve(WRITE_SIZE);
+}
+
+OutputFile::~OutputFile() {
+    this->flush();
+    if (this->is_owned) CloseHandle(this->handle);
+}
+
+void OutputFile::write_through(std::string_view data) noexcept {
+    while (!data.empty() && !this->failed) {
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size(), 1u << 30));
+        DWORD written = 0;
+        if (!WriteFile(this->handle, data.data(), chunk, &written, nullptr)) {
+            this->failed = true;
+            return;
+        }
+        data.remove_prefix(written);
+    }
+}
+#else
+///Reads file till its end.
+///
+///@return false If read fails.
+static bool read_whole(int file, std::string& result) {
+    char chunk[64 * 1024];
+    for (;;) {
+        const ssize_t count = ::read(file, chunk, sizeof(chunk));
+        if (count == 0) return true;
+        if (count > 0) result.append(chunk, static_cast<size_t>(count));
+        else if (errno != EINTR) return false;
+    }
+}
+
+MappedFile::MappedFile(const std::string& path) : data(nullptr), size(0) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file == -1) throw std::runtime_error("Cannot open file: " + path + ": " + std::strerror(errno));
+
+    struct stat info;
+    if (fstat(file, &info) == -1) {
+        close(file);
+        throw std::runtime_error("Cannot get size of file: " + path);
+    }
+
+    //Pipe or device has no size to map, so it is read as stream.
+    if (!S_ISREG(info.st_mode)) {
+        const auto is_read = read_whole(file, this->buffer);
+        close(file);
+        if (!is_read) throw std::runtime_error("Cannot read file: " + path + ": " + std::strerror(errno));
+
+        this->data = this->buffer.data();
+        this->size = this->buffer.size();
+        return;
+    }
+
+    //Empty file cannot be mapped.
+    if (info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Cannot map file: " + path + ": " + std::strerror(errno));
+        }
+
+        //Input is read once from start to end.
+        madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+        this->data = static_cast<const char*>(mapped);
+        this->size = static_cast<size_t>(info.st_size);
+    }
+
+    //Mapping keeps file open.
+    close(file);
+}
+
+MappedFile::~MappedFile() {
+    if (this->data != nullptr && this->data != this->buffer.data()) munmap(const_cast<char*>(this->data), this->size);
+}
+
+bool corpus::is_same_file(const std::string& left, const std::string& right) {
+    struct stat left_info;
+    struct stat right_info;
+    if (stat(left.c_str(), &left_info) == -1 || stat(right.c_str(), &right_info) == -1) return false;
+
+    return left_info.st_dev == right_info.st_dev && left_info.st_ino == right_info.st_ino;
+}
+
+InputFile::InputFile(const std::string& path) : handle(STDIN_FILENO), is_owned(!path.empty()) {
+    if (this->is_owned) {
+        this->handle = open(path.c_str(), O_RDONLY);
+        if (this->handle == -1) throw std::runtime_error("Cannot open file: " + path + ": " + std::strerror(errno));
+    }
+}
+
+InputFile::~InputFile() {
+    if (this->is_owned) close(this->handle);
+}
+
+size_t InputFile::read(char* buffer, size_t size) {
+    for (;;) {
+        const ssize_t count = ::read(this->handle, buffer, size);
+        if (count >= 0) return static_cast<size_t>(count);
+        if (errno != EINTR) throw std::runtime_error(std::string("Failed to read input: ") + std::strerror(errno));
+    }
+}
+
+bool InputFile::is_interactive() const noexcept {
+    return isatty(this->handle) == 1;
+}
+
+OutputFile::OutputFile(const std::string& path) : handle(STDOUT_FILENO), is_owned(!path.empty()), failed(false) {
+    if (this->is_owned) {
+        this->handle = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (this->handle == -1) throw std::runtime_error("Cannot open file: " + path + ": " + std::strerror(errno));
+    }
+    this->buffer.reserve(WRITE_SIZE);
+}
+
+OutputFile::~OutputFile() {
+    this->flush();
+    if (this->is_owned) close(this->handle);
+}
+
+void OutputFile::write_through(std::string_view data) noexcept {
+    while (!data.empty() && !this->failed) {
+        const ssize_t written = ::write(this->handle, data.data(), data.size());
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            this->failed = true;
+            return;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+#endif
+
+std::string_view MappedFile::view() const noexcept {
+    return std::string_view(this->data, this->size);
+}
+
+void OutputFile::write(std::string_view data) {
+    if (this->buffer.size() + data.size() > WRITE_SIZE) {
+        this->flush();
+    }
+
+    //Big chunk is written as it is, instead of copying it into buffer.
+    if (data.size() >= WRITE_SIZE) {
+        this->write_through(data);
+    }
+    else {
+        this->buffer.append(data);
+    }
+}
+
+void OutputFile::flush() noexcept {
+    this->write_through(this->buffer);
+    this->buffer.clear();
+}
+
+bool OutputFile::is_ok() const noexcept {
+    return !this->failed;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace corpus {
+    /**
+     * Read-only file mapped into memory.
+     *
+     * Content is accessed directly, without copying it into buffers.
+     * Pipe or device cannot be mapped, so it is read whole into buffer instead.
+     */
+    class MappedFile {
+        private:
+            const char* data;
+            size_t size;
+#ifdef _WIN32
+            void* mapping;
+#endif
+            ///Content of file, that is not mapped.
+            std::string buffer;
+
+        public:
+            ///Maps whole file.
+            ///
+            ///@throws runtime_error When file cannot be opened or mapped.
+            explicit MappedFile(const std::string& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            ///@return Content of file.
+            std::string_view view() const noexcept;
+    };
+
+    ///@return Whether both paths refer to the same existing file, like input and output.
+    bool is_same_file(const std::string& left, const std::string& right);
+
+    /**
+     * Input file, which is read by big blocks, bypassing stream buffering.
+     */
+    class InputFile {
+        private:
+#ifdef _WIN32
+            void* handle;
+#else
+            int handle;
+#endif
+            bool is_owned;
+
+        public:
+            ///Opens file for reading.
+            ///
+            ///@param path Path to file, stdin if empty.
+            ///@throws runtime_error When file cannot be opened.
+            explicit InputFile(const std::string& path);
+            ~InputFile();
+
+            InputFile(const InputFile&) = delete;
+            InputFile& operator=(const InputFile&) = delete;
+
+            ///Reads whatever is available, waiting only if there is nothing.
+            ///
+            ///@return Number of bytes read, 0 at the end of file.
+            ///@throws runtime_error When read fails.
+            size_t read(char* buffer, size_t size);
+            ///@return Whether input comes from terminal.
+            bool is_interactive() const noexcept;
+    };
+
+    /**
+     * Output file, which coalesces small writes into big ones.
+     *
+     * Writes go straight to OS, bypassing stream buffering.
+     */
+    class OutputFile {
+        private:
+#ifdef _WIN32
+            void* handle;
+#else
+            int handle;
+#endif
+            bool is_owned;
+            bool failed;
+            std::string buffer;
+
+            void write_through(std::string_view data) noexcept;
+
+        public:
+            ///Opens file for writing, truncating it.
+            ///
+            ///@param path Path to file, stdout if empty.
+            ///@throws runtime_error When file cannot be opened.
+            explicit OutputFile(const std::string& path);
+            ///Flushes and closes file.
+            ~OutputFile();
+
+            OutputFile(const OutputFile&) = delete;
+            OutputFile& operator=(const OutputFile&) = delete;
+
+            void write(std::string_view data);
+            void flush() noexcept;
+            ///@return Whether all writes so far succeeded.
+            bool is_ok() const noexcept;
+    };
+}
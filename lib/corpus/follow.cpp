@@ -0,0 +1,290 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <text/text.hpp>
+
+#include "follow.hpp"
+
+using namespace corpus;
+
+///Size of single read of appended content.
+static constexpr size_t READ_SIZE = 64 * 1024;
+
+///Moves complete lines of `data` into `lines`, keeping the rest in `carry`.
+static void split_lines(std::string_view data, std::string& carry, std::string& lines) {
+    const size_t end = data.rfind('\n');
+    if (end == std::string_view::npos) {
+        carry.append(data);
+        return;
+    }
+
+    lines.append(carry);
+    lines.append(data.substr(0, end + 1));
+    carry.assign(data.substr(end + 1));
+}
+
+#ifdef _WIN32
+static bool is_same_file(HANDLE left, HANDLE right) {
+    BY_HANDLE_FILE_INFORMATION left_info;
+    BY_HANDLE_FILE_INFORMATION right_info;
+    if (!GetFileInformationByHandle(left, &left_info) || !GetFileInformationByHandle(right, &right_info)) return true;
+
+    return left_info.dwVolumeSerialNumber == right_info.dwVolumeSerialNumber &&
+           left_info.nFileIndexHigh == right_info.nFileIndexHigh &&
+           left_info.nFileIndexLow == right_info.nFileIndexLow;
+}
+
+///Opens file so that writer can still append, rename or remove it.
+static HANDLE open_shared(const std::wstring& path) {
+    return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+}
+
+Follower::Follower(const std::string& path) : path(path), file(INVALID_HANDLE_VALUE), change(INVALID_HANDLE_VALUE), wake(nullptr), offset(0) {
+    const auto wide_path = text::to_wide_string(path);
+    const auto separator = wide_path.find_last_of(L"\\/");
+    const auto dir = separator == std::wstring::npos ? std::wstring(L".") : wide_path.substr(0, separator + 1);
+
+    this->file = open_shared(wide_path);
+    if (this->file == INVALID_HANDLE_VALUE) throw std::runtime_error("Cannot open file: " + path);
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(this->file, &size)) {
+        CloseHandle(this->file);
+        throw std::runtime_error("Cannot get size of file: " + path);
+    }
+    this->offset = static_cast<uint64_t>(size.QuadPart);
+
+    //Notifications are only per directory, so they cover both appends and rotation.
+    this->change = FindFirstChangeNotificationW(dir.c_str(), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+    this->wake = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (this->change == INVALID_HANDLE_VALUE || this->wake == nullptr) {
+        if (this->change != INVALID_HANDLE_VALUE) FindCloseChangeNotification(this->change);
+        if (this->wake != nullptr) CloseHandle(this->wake);
+        CloseHandle(this->file);
+        throw std::runtime_error("Cannot watch file: " + path);
+    }
+}
+
+Follower::~Follower() {
+    FindCloseChangeNotification(this->change);
+    CloseHandle(this->wake);
+    CloseHandle(this->file);
+}
+
+void Follower::drain(std::string& lines) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(this->file, &size)) throw std::runtime_error("Cannot get size of file: " + this->path);
+    //Truncated, so its content is new.
+    if (static_cast<uint64_t>(size.QuadPart) < this->offset) {
+        this->offset = 0;
+        this->carry.clear();
+    }
+
+    char buffer[READ_SIZE];
+    for (;;) {
+        OVERLAPPED position = {};
+        position.Offset = static_cast<DWORD>(this->offset);
+        position.OffsetHigh = static_cast<DWORD>(this->offset >> 32);
+
+        DWORD count = 0;
+        if (!ReadFile(this->file, buffer, sizeof(buffer), &count, &position)) {
+            if (GetLastError() == ERROR_HANDLE_EOF) return;
+            throw std::runtime_error("Failed to read file: " + this->path);
+        }
+        if (count == 0) return;
+
+        this->offset += count;
+        split_lines(std::string_view(buffer, count), this->carry, lines);
+    }
+}
+
+void Follower::reopen(std::string& lines) {
+    const HANDLE candidate = open_shared(text::to_wide_string(this->path));
+    //Not yet replaced after removal.
+    if (candidate == INVALID_HANDLE_VALUE) return;
+    if (is_same_file(this->file, candidate)) {
+        CloseHandle(candidate);
+        return;
+    }
+
+    this->drain(lines);
+    //Nothing is going to be appended to the old file.
+    if (!this->carry.empty()) {
+        lines.append(this->carry);
+        lines.push_back('\n');
+        this->carry.clear();
+    }
+
+    CloseHandle(this->file);
+    this->file = candidate;
+    this->offset = 0;
+}
+
+bool Follower::wait(bool& replaced) {
+    const HANDLE handles[] = {this->wake, this->change};
+    const DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    if (result == WAIT_OBJECT_0) return false;
+    if (result != WAIT_OBJECT_0 + 1) throw std::runtime_error("Failed to wait for change of file: " + this->path);
+
+    FindNextChangeNotification(this->change);
+    //Notification doesn't tell which file has changed.
+    replaced = true;
+    return true;
+}
+
+void Follower::stop() noexcept {
+    SetEvent(this->wake);
+}
+#else
+///Changes of followed file itself.
+static constexpr uint32_t FILE_EVENTS = IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF;
+///Changes of directory, that put new file at path.
+static constexpr uint32_t DIR_EVENTS = IN_CREATE | IN_MOVED_TO;
+
+Follower::Follower(const std::string& path) : path(path), file(-1), notify(-1), file_watch(-1), dir_watch(-1), wake(-1), offset(0) {
+    const auto separator = path.rfind('/');
+    const auto dir = separator == std::string::npos ? std::string(".") : path.substr(0, separator + 1);
+    this->name = separator == std::string::npos ? path : path.substr(separator + 1);
+
+    const auto fail = [this](const std::string& message) {
+        const auto reason = message + this->path + ": " + std::strerror(errno);
+        if (this->wake != -1) close(this->wake);
+        if (this->notify != -1) close(this->notify);
+        if (this->file != -1) close(this->file);
+        return std::runtime_error(reason);
+    };
+
+    this->file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (this->file == -1) throw fail("Cannot open file: ");
+
+    struct stat info;
+    if (fstat(this->file, &info) == -1) throw fail("Cannot get size of file: ");
+    this->offset = static_cast<uint64_t>(info.st_size);
+
+    this->notify = inotify_init1(IN_CLOEXEC);
+    if (this->notify == -1) throw fail("Cannot watch file: ");
+    this->wake = eventfd(0, EFD_CLOEXEC);
+    if (this->wake == -1) throw fail("Cannot watch file: ");
+
+    //Directory is watched as well to notice new file, once old one is rotated.
+    this->file_watch = inotify_add_watch(this->notify, path.c_str(), FILE_EVENTS);
+    this->dir_watch = inotify_add_watch(this->notify, dir.c_str(), DIR_EVENTS);
+    if (this->file_watch == -1 || this->dir_watch == -1) throw fail("Cannot watch file: ");
+}
+
+Follower::~Follower() {
+    close(this->wake);
+    close(this->notify);
+    close(this->file);
+}
+
+void Follower::drain(std::string& lines) {
+    struct stat info;
+    if (fstat(this->file, &info) == -1) throw std::runtime_error("Cannot get size of file: " + this->path + ": " + std::strerror(errno));
+    //Truncated, so its content is new.
+    if (static_cast<uint64_t>(info.st_size) < this->offset) {
+        this->offset = 0;
+        this->carry.clear();
+    }
+
+    char buffer[READ_SIZE];
+    for (;;) {
+        const ssize_t count = pread(this->file, buffer, sizeof(buffer), static_cast<off_t>(this->offset));
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to read file: " + this->path + ": " + std::strerror(errno));
+        }
+        if (count == 0) return;
+
+        this->offset += static_cast<uint64_t>(count);
+        split_lines(std::string_view(buffer, static_cast<size_t>(count)), this->carry, lines);
+    }
+}
+
+void Follower::reopen(std::string& lines) {
+    const int candidate = open(this->path.c_str(), O_RDONLY | O_CLOEXEC);
+    //Not yet replaced after removal.
+    if (candidate == -1) return;
+
+    struct stat current;
+    struct stat info;
+    if (fstat(candidate, &current) == -1 || fstat(this->file, &info) == -1 || (current.st_dev == info.st_dev && current.st_ino == info.st_ino)) {
+        close(candidate);
+        return;
+    }
+
+    this->drain(lines);
+    //Nothing is going to be appended to the old file.
+    if (!this->carry.empty()) {
+        lines.append(this->carry);
+        lines.push_back('\n');
+        this->carry.clear();
+    }
+
+    //Old file may be gone already, together with its watch.
+    inotify_rm_watch(this->notify, this->file_watch);
+    close(this->file);
+    this->file = candidate;
+    this->file_watch = inotify_add_watch(this->notify, this->path.c_str(), FILE_EVENTS);
+    this->offset = 0;
+}
+
+bool Follower::wait(bool& replaced) {
+    pollfd fds[] = {{this->notify, POLLIN, 0}, {this->wake, POLLIN, 0}};
+    while (poll(fds, 2, -1) == -1) {
+        if (errno != EINTR) throw std::runtime_error("Failed to wait for change of file: " + this->path + ": " + std::strerror(errno));
+    }
+    if (fds[1].revents != 0) return false;
+
+    alignas(inotify_event) char buffer[4096];
+    const ssize_t size = read(this->notify, buffer, sizeof(buffer));
+    if (size == -1) {
+        if (errno == EINTR) return true;
+        throw std::runtime_error("Failed to wait for change of file: " + this->path + ": " + std::strerror(errno));
+    }
+
+    for (ssize_t pos = 0; pos < size;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(buffer + pos);
+        if (event->wd == this->dir_watch) {
+            if (event->len > 0 && this->name == event->name) replaced = true;
+        }
+        else if (event->wd == this->file_watch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) != 0) {
+            replaced = true;
+        }
+        pos += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+    }
+
+    return true;
+}
+
+void Follower::stop() noexcept {
+    //Counter stays non-zero, so every following wait returns at once.
+    const uint64_t value = 1;
+    [[maybe_unused]] const auto result = write(this->wake, &value, sizeof(value));
+}
+#endif
+
+bool Follower::next(std::string& lines) {
+    lines.clear();
+
+    for (;;) {
+        this->drain(lines);
+        if (!lines.empty()) return true;
+
+        bool replaced = false;
+        if (!this->wait(replaced)) return false;
+        if (replaced) this->reopen(lines);
+    }
+}
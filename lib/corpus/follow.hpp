@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace corpus {
+    /**
+     * Log file, that is followed as it grows, like `tail -F`.
+     *
+     * Waits for changes using OS notifications (inotify on Linux), so nothing is polled
+     * and every appended byte is read exactly once.
+     *
+     * - Reading starts at the current end of file.
+     * - Truncated file is read from its start again.
+     * - Once file is replaced (rotated), the rest of the old one is read and then the new one is followed from its start.
+     */
+    class Follower {
+        private:
+            std::string path;
+#ifdef _WIN32
+            void* file;
+            void* change;
+            void* wake;
+#else
+            int file;
+            int notify;
+            int file_watch;
+            int dir_watch;
+            int wake;
+            ///Name of file within its directory.
+            std::string name;
+#endif
+            uint64_t offset;
+            ///Incomplete last line.
+            std::string carry;
+
+            ///Reads everything appended since the last read.
+            void drain(std::string& lines);
+            ///Switches to file, that is currently at path, if it has been replaced.
+            void reopen(std::string& lines);
+            ///Waits for change of file.
+            ///
+            ///@return false if stopped.
+            bool wait(bool& replaced);
+
+        public:
+            ///Starts following file from its end.
+            ///
+            ///@throws runtime_error When file cannot be opened or watched.
+            explicit Follower(const std::string& path);
+            ~Follower();
+
+            Follower(const Follower&) = delete;
+            Follower& operator=(const Follower&) = delete;
+
+            ///Waits until there are new complete lines.
+            ///
+            ///@param lines Receives lines with their terminators.
+            ///@return false once stopped.
+            ///@throws runtime_error When file cannot be read.
+            bool next(std::string& lines);
+            ///Makes `next` return false. Can be called from any thread.
+            void stop() noexcept;
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace corpus {
+    /**
+     * Bounded lock-free queue for multiple producers and consumers.
+     *
+     * Each cell has sequence number, which tells whether cell is free for producer
+     * or filled for consumer of the current lap, so that producers and consumers
+     * only contend on their own index.
+     *
+     * Blocking operations yield for a while, as pipeline stages are expected to be busy
+     * most of the time, and then park on condition variable. Opposite side takes lock to
+     * notify only when there is parked thread, so that busy queue stays lock-free.
+     */
+    template<typename T>
+    class Queue {
+        private:
+            struct Cell {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            std::unique_ptr<Cell[]> cells;
+            size_t mask;
+            alignas(64) std::atomic<size_t> head;
+            alignas(64) std::atomic<size_t> tail;
+
+            ///Parked threads and what they wait for.
+            std::mutex lock;
+            std::condition_variable not_full;
+            std::condition_variable not_empty;
+            std::atomic<size_t> pushers;
+            std::atomic<size_t> poppers;
+
+            ///Attempts before blocking operation parks.
+            static constexpr unsigned YIELDS = 64;
+
+            bool enqueue(T& value) {
+                size_t pos = this->tail.load(std::memory_order_relaxed);
+
+                for (;;) {
+                    Cell& cell = this->cells[pos & this->mask];
+                    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+                    if (diff == 0) {
+                        if (this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            cell.value = std::move(value);
+                            cell.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false;
+                    }
+                    else {
+                        pos = this->tail.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool dequeue(T& value) {
+                size_t pos = this->head.load(std::memory_order_relaxed);
+
+                for (;;) {
+                    Cell& cell = this->cells[pos & this->mask];
+                    const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                    const auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+                    if (diff == 0) {
+                        if (this->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            value = std::move(cell.value);
+                            cell.sequence.store(pos + this->mask + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false;
+                    }
+                    else {
+                        pos = this->head.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            ///Sleeps until `attempt` succeeds.
+            ///
+            ///Thread is counted in `waiters` before the last attempt, so that it either sees
+            ///the change or the one, who made it, sees thread and wakes it.
+            template<typename F>
+            void park(std::condition_variable& condition, std::atomic<size_t>& waiters, F&& attempt) {
+                std::unique_lock<std::mutex> guard(this->lock);
+                waiters.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                condition.wait(guard, attempt);
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            ///Wakes parked thread after change, if there is one.
+            void wake(std::condition_variable& condition, const std::atomic<size_t>& waiters) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (waiters.load(std::memory_order_relaxed) == 0) return;
+
+                //Parked thread holds lock till it waits, so that notification is not lost.
+                {
+                    const std::lock_guard<std::mutex> guard(this->lock);
+                }
+                condition.notify_one();
+            }
+
+        public:
+            ///Creates queue, which capacity is rounded up to power of 2.
+            explicit Queue(size_t capacity) : head(0), tail(0), pushers(0), poppers(0) {
+                size_t size = 2;
+                while (size < capacity) size *= 2;
+
+                this->cells.reset(new Cell[size]);
+                this->mask = size - 1;
+                for (size_t idx = 0; idx < size; idx++) {
+                    this->cells[idx].sequence.store(idx, std::memory_order_relaxed);
+                }
+            }
+
+            Queue(const Queue&) = delete;
+            Queue& operator=(const Queue&) = delete;
+
+            ///Moves value into queue unless it is full.
+            bool try_push(T& value) {
+                if (!this->enqueue(value)) return false;
+
+                this->wake(this->not_empty, this->poppers);
+                return true;
+            }
+
+            ///Moves value out of queue unless it is empty.
+            bool try_pop(T& value) {
+                if (!this->dequeue(value)) return false;
+
+                this->wake(this->not_full, this->pushers);
+                return true;
+            }
+
+            ///Waits until there is room for value.
+            void push(T&& value) {
+                for (unsigned attempt = 0; !this->enqueue(value); attempt++) {
+                    if (attempt < YIELDS) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    this->park(this->not_full, this->pushers, [this, &value]() {
+                        return this->enqueue(value);
+                    });
+                    break;
+                }
+                this->wake(this->not_empty, this->poppers);
+            }
+
+            ///Waits until there is value.
+            T pop() {
+                T result;
+                for (unsigned attempt = 0; !this->dequeue(result); attempt++) {
+                    if (attempt < YIELDS) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    this->park(this->not_empty, this->poppers, [this, &result]() {
+                        return this->dequeue(result);
+                    });
+                    break;
+                }
+                this->wake(this->not_full, this->pushers);
+                return result;
+            }
+    };
+}
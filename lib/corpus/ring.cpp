@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <text/text.hpp>
+
+#include "ring.hpp"
+
+using namespace corpus;
+
+static size_t ring_size(uint32_t slot_count, uint32_t slot_size) noexcept {
+    return sizeof(ring::Header) + static_cast<size_t>(slot_count) * slot_size;
+}
+
+///Sets up header of freshly created ring.
+static ring::Header* init_header(void* memory, uint32_t slot_count, uint32_t slot_size) noexcept {
+    auto* header = new (memory) ring::Header();
+    header->magic = ring::MAGIC;
+    header->version = ring::VERSION;
+    header->slot_count = slot_count;
+    header->slot_size = slot_size;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->waiting.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_release);
+    return header;
+}
+
+///Checks that ring is created by compatible consumer.
+static ring::Header* check_header(void* memory, size_t size, const std::string& name) {
+    auto* header = static_cast<ring::Header*>(memory);
+    if (size < sizeof(ring::Header) || header->magic != ring::MAGIC || header->version != ring::VERSION || size < ring_size(header->slot_count, header->slot_size)) {
+        throw std::runtime_error("Incompatible ring: " + name);
+    }
+    return header;
+}
+
+#ifdef _WIN32
+RingMapping::RingMapping(const std::string& name, uint32_t slot_count, uint32_t slot_size) : name(name), is_owner(true), mapping(nullptr), event(nullptr), memory(nullptr), size(ring_size(slot_count, slot_size)) {
+    const auto wide_name = text::to_wide_string("Local\\" + name);
+    this->mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(this->size) >> 32), static_cast<DWORD>(this->size), wide_name.c_str());
+    if (this->mapping == nullptr) throw std::runtime_error("Cannot create ring: " + name);
+    //Named memory is gone with its last handle, so existing one belongs to running consumer.
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(this->mapping);
+        throw std::runtime_error("Ring is already in use: " + name);
+    }
+
+    this->memory = MapViewOfFile(this->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    this->event = CreateEventW(nullptr, FALSE, FALSE, (wide_name + L".wake").c_str());
+    if (this->memory == nullptr || this->event == nullptr) {
+        if (this->memory != nullptr) UnmapViewOfFile(this->memory);
+        if (this->event != nullptr) CloseHandle(this->event);
+        CloseHandle(this->mapping);
+        throw std::runtime_error("Cannot map ring: " + name);
+    }
+
+    this->header = init_header(this->memory, slot_count, slot_size);
+    this->slots = static_cast<char*>(this->memory) + sizeof(ring::Header);
+}
+
+RingMapping::RingMapping(const std::string& name) : name(name), is_owner(false), mapping(nullptr), event(nullptr), memory(nullptr), size(0) {
+    const auto wide_name = text::to_wide_string("Local\\" + name);
+    this->mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, wide_name.c_str());
+    if (this->mapping == nullptr) throw std::runtime_error("Cannot open ring: " + name);
+
+    this->memory = MapViewOfFile(this->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    this->event = CreateEventW(nullptr, FALSE, FALSE, (wide_name + L".wake").c_str());
+    MEMORY_BASIC_INFORMATION info;
+    if (this->memory == nullptr || this->event == nullptr || VirtualQuery(this->memory, &info, sizeof(info)) == 0) {
+        if (this->memory != nullptr) UnmapViewOfFile(this->memory);
+        if (this->event != nullptr) CloseHandle(this->event);
+        CloseHandle(this->mapping);
+        throw std::runtime_error("Cannot map ring: " + name);
+    }
+    this->size = info.RegionSize;
+
+    try {
+        this->header = check_header(this->memory, this->size, name);
+    }
+    catch (...) {
+        UnmapViewOfFile(this->memory);
+        CloseHandle(this->event);
+        CloseHandle(this->mapping);
+        throw;
+    }
+    this->slots = static_cast<char*>(this->memory) + sizeof(ring::Header);
+}
+
+RingMapping::~RingMapping() {
+    if (this->is_owner) this->close();
+    UnmapViewOfFile(this->memory);
+    CloseHandle(this->event);
+    CloseHandle(this->mapping);
+}
+
+void RingMapping::wait(uint64_t tail) noexcept {
+    this->header->waiting.store(1);
+    if (this->header->head.load() == tail && this->header->closed.load() == 0) {
+        WaitForSingleObject(this->event, INFINITE);
+    }
+    this->header->waiting.store(0);
+}
+
+void RingMapping::wake() noexcept {
+    if (this->header->waiting.exchange(0) == 1) SetEvent(this->event);
+}
+#else
+static std::string shm_name(const std::string& name) {
+    return "/" + name;
+}
+
+///Removes ring left by crashed consumer.
+///
+///@return false If ring is locked by running consumer.
+static bool remove_stale(const std::string& path) {
+    const int file = shm_open(path.c_str(), O_RDWR, 0);
+    if (file == -1) return errno == ENOENT;
+
+    //Lock is held while ring is removed, so that consumer, that has just created it, sees it gone.
+    const bool is_stale = flock(file, LOCK_EX | LOCK_NB) == 0;
+    if (is_stale) shm_unlink(path.c_str());
+    ::close(file);
+    return is_stale;
+}
+
+RingMapping::RingMapping(const std::string& name, uint32_t slot_count, uint32_t slot_size) : name(name), is_owner(true), file(-1), memory(nullptr), size(ring_size(slot_count, slot_size)) {
+    const auto path = shm_name(name);
+    int file = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    //Running consumer keeps its ring locked, while crashed one leaves it unlocked.
+    if (file == -1 && errno == EEXIST) {
+        if (!remove_stale(path)) throw std::runtime_error("Ring is already in use: " + name);
+        file = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (file == -1 && errno == EEXIST) throw std::runtime_error("Ring is already in use: " + name);
+    }
+    if (file == -1) throw std::runtime_error("Cannot create ring: " + name + ": " + std::strerror(errno));
+
+    //Other consumer may have taken ring for stale and removed it, before it is locked.
+    struct stat info;
+    if (flock(file, LOCK_EX | LOCK_NB) == -1 || fstat(file, &info) == -1 || info.st_nlink == 0) {
+        ::close(file);
+        throw std::runtime_error("Ring is already in use: " + name);
+    }
+
+    if (ftruncate(file, static_cast<off_t>(this->size)) == -1) {
+        const auto reason = std::string(std::strerror(errno));
+        shm_unlink(path.c_str());
+        ::close(file);
+        throw std::runtime_error("Cannot create ring: " + name + ": " + reason);
+    }
+
+    this->memory = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (this->memory == MAP_FAILED) {
+        const auto reason = std::string(std::strerror(errno));
+        shm_unlink(path.c_str());
+        ::close(file);
+        throw std::runtime_error("Cannot map ring: " + name + ": " + reason);
+    }
+
+    //Lock lasts as long as file is open.
+    this->file = file;
+    this->header = init_header(this->memory, slot_count, slot_size);
+    this->slots = static_cast<char*>(this->memory) + sizeof(ring::Header);
+}
+
+RingMapping::RingMapping(const std::string& name) : name(name), is_owner(false), file(-1), memory(nullptr), size(0) {
+    const int file = shm_open(shm_name(name).c_str(), O_RDWR, 0);
+    if (file == -1) throw std::runtime_error("Cannot open ring: " + name + ": " + std::strerror(errno));
+
+    struct stat info;
+    if (fstat(file, &info) == -1 || info.st_size == 0) {
+        ::close(file);
+        throw std::runtime_error("Incompatible ring: " + name);
+    }
+    this->size = static_cast<size_t>(info.st_size);
+
+    this->memory = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    const auto reason = std::string(std::strerror(errno));
+    ::close(file);
+    if (this->memory == MAP_FAILED) throw std::runtime_error("Cannot map ring: " + name + ": " + reason);
+
+    try {
+        this->header = check_header(this->memory, this->size, name);
+    }
+    catch (...) {
+        munmap(this->memory, this->size);
+        throw;
+    }
+    this->slots = static_cast<char*>(this->memory) + sizeof(ring::Header);
+}
+
+RingMapping::~RingMapping() {
+    if (this->is_owner) {
+        this->close();
+        //Ring is removed while still locked, so that it is never taken for stale one.
+        shm_unlink(shm_name(this->name).c_str());
+        ::close(this->file);
+    }
+    munmap(this->memory, this->size);
+}
+
+//Futex is not private, as it is shared between processes.
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Futex word should be plain integer");
+
+void RingMapping::wait(uint64_t tail) noexcept {
+    this->header->waiting.store(1);
+    //Producer, that has moved head after that, sees waiting flag.
+    if (this->header->head.load() == tail && this->header->closed.load() == 0) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->header->waiting), FUTEX_WAIT, 1, nullptr, nullptr, 0);
+    }
+    this->header->waiting.store(0);
+}
+
+void RingMapping::wake() noexcept {
+    if (this->header->waiting.exchange(0) == 1) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&this->header->waiting), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    }
+}
+#endif
+
+char* RingMapping::slot(uint64_t seq) const noexcept {
+    return this->slots + static_cast<size_t>(seq % this->header->slot_count) * this->header->slot_size;
+}
+
+void RingMapping::close() noexcept {
+    this->header->closed.store(1);
+    this->wake();
+}
+
+static uint32_t align_slot(uint32_t slot_size) {
+    if (slot_size <= ring::SLOT_HEADER || slot_size > (1u << 30)) throw std::runtime_error("Invalid size of ring slot");
+    return static_cast<uint32_t>((slot_size + ring::ALIGN - 1) / ring::ALIGN * ring::ALIGN);
+}
+
+RingConsumer::RingConsumer(const std::string& name, uint32_t slot_count, uint32_t slot_size) : ring(name, slot_count > 0 ? slot_count : 1, align_slot(slot_size)), is_reading(false) {
+}
+
+bool RingConsumer::next(std::string_view& line) noexcept {
+    auto* header = this->ring.header;
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+
+    //Slot is handed back only now, as line has been used from it in place.
+    if (this->is_reading) {
+        tail += 1;
+        header->tail.store(tail, std::memory_order_release);
+        this->is_reading = false;
+    }
+
+    while (header->head.load(std::memory_order_acquire) == tail) {
+        if (header->closed.load(std::memory_order_acquire) != 0) {
+            //Producer might have written something just before closing.
+            if (header->head.load(std::memory_order_acquire) == tail) return false;
+            break;
+        }
+        this->ring.wait(tail);
+    }
+
+    const char* slot = this->ring.slot(tail);
+    uint32_t size;
+    std::memcpy(&size, slot, sizeof(size));
+    //Producer is not trusted to keep within slot.
+    size = std::min<uint32_t>(size, header->slot_size - static_cast<uint32_t>(ring::SLOT_HEADER));
+
+    line = std::string_view(slot + ring::SLOT_HEADER, size);
+    this->is_reading = true;
+    return true;
+}
+
+void RingConsumer::close() noexcept {
+    this->ring.close();
+}
+
+RingProducer::RingProducer(const std::string& name) : ring(name) {
+}
+
+bool RingProducer::try_push(std::string_view line) {
+    auto* header = this->ring.header;
+    if (line.size() > header->slot_size - ring::SLOT_HEADER) throw std::length_error("Line doesn't fit into ring slot");
+
+    const uint64_t head = header->head.load(std::memory_order_relaxed);
+    if (head - header->tail.load(std::memory_order_acquire) >= header->slot_count) return false;
+
+    char* slot = this->ring.slot(head);
+    const auto size = static_cast<uint32_t>(line.size());
+    std::memcpy(slot, &size, sizeof(size));
+    std::memcpy(slot + ring::SLOT_HEADER, line.data(), line.size());
+
+    //Sequentially consistent, so that either consumer sees new head or producer sees it waiting.
+    header->head.store(head + 1);
+    this->ring.wake();
+    return true;
+}
+
+bool RingProducer::push(std::string_view line) {
+    //Consumer is normally far ahead, so full ring is rare enough to just yield.
+    while (!this->try_push(line)) {
+        if (this->ring.header->closed.load(std::memory_order_acquire) != 0) return false;
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void RingProducer::close() noexcept {
+    this->ring.close();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace corpus {
+    /**
+     * Layout of shared-memory ring, through which hook process passes lines.
+     *
+     * Memory is header followed by `slot_count` slots of `slot_size` bytes.
+     * Slot starts with `uint32_t` size of line, followed by its UTF-8 bytes without terminator.
+     *
+     * Ring has single producer and single consumer:
+     *
+     * - Producer fills slot `head % slot_count` and then increments `head`.
+     * - Consumer reads slot `tail % slot_count` and then increments `tail`.
+     * - Consumer sets `waiting` to 1 before going to sleep, producer resets it to 0 and wakes consumer up.
+     *   On Linux it is futex word, on Windows there is also event named after ring with `.wake` suffix.
+     */
+    namespace ring {
+        static constexpr uint32_t MAGIC = 0x52545456;
+        static constexpr uint32_t VERSION = 1;
+        static constexpr size_t ALIGN = 64;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slot_count;
+            uint32_t slot_size;
+
+            ///Number of slots written by producer.
+            alignas(ALIGN) std::atomic<uint64_t> head;
+            ///Number of slots read by consumer.
+            alignas(ALIGN) std::atomic<uint64_t> tail;
+            alignas(ALIGN) std::atomic<uint32_t> waiting;
+            ///Set once either side is done.
+            std::atomic<uint32_t> closed;
+        };
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring requires lock-free 64-bit atomics");
+        static_assert(sizeof(Header) % ALIGN == 0, "Slots should start at cache line");
+
+        ///Space before line in slot.
+        static constexpr size_t SLOT_HEADER = sizeof(uint32_t);
+    }
+
+    ///Shared memory of ring.
+    class RingMapping {
+        private:
+            std::string name;
+            bool is_owner;
+#ifdef _WIN32
+            void* mapping;
+            void* event;
+#else
+            ///Shared memory, that owner keeps locked, so that its ring is seen as in use.
+            int file;
+#endif
+            void* memory;
+            size_t size;
+
+        public:
+            ring::Header* header;
+            char* slots;
+
+            ///Creates ring as its owner, that removes it on destruction.
+            ///
+            ///@throws runtime_error When ring is already owned by running consumer.
+            RingMapping(const std::string& name, uint32_t slot_count, uint32_t slot_size);
+            ///Opens existing ring.
+            explicit RingMapping(const std::string& name);
+            ~RingMapping();
+
+            RingMapping(const RingMapping&) = delete;
+            RingMapping& operator=(const RingMapping&) = delete;
+
+            ///@return Slot by its sequence number.
+            char* slot(uint64_t seq) const noexcept;
+            ///Sleeps until `head` moves past `tail` or ring is closed.
+            void wait(uint64_t tail) noexcept;
+            ///Wakes up consumer, if it sleeps.
+            void wake() noexcept;
+            ///Marks ring as closed and wakes up consumer.
+            void close() noexcept;
+    };
+
+    /**
+     * Consumer side of ring, that is owned by vn-text-trim.
+     *
+     * Lines are read in place, directly from shared memory.
+     */
+    class RingConsumer {
+        private:
+            RingMapping ring;
+            ///Whether slot of the last line is still in use.
+            bool is_reading;
+
+        public:
+            static constexpr uint32_t DEFAULT_SLOT_COUNT = 1024;
+            static constexpr uint32_t DEFAULT_SLOT_SIZE = 4096;
+
+            ///Creates ring, replacing one, that is left by crashed consumer.
+            ///
+            ///@param name Name of ring without slashes.
+            ///@param slot_size Size of slot including its header, rounded up to cache line.
+            ///@throws runtime_error When shared memory cannot be created.
+            explicit RingConsumer(const std::string& name, uint32_t slot_count = DEFAULT_SLOT_COUNT, uint32_t slot_size = DEFAULT_SLOT_SIZE);
+
+            ///Waits for the next line.
+            ///
+            ///@param line Receives line, that is valid until the next call.
+            ///@return false once ring is closed and empty.
+            bool next(std::string_view& line) noexcept;
+            ///Makes `next` return false, once ring is empty. Can be called from any thread.
+            void close() noexcept;
+    };
+
+    /**
+     * Producer side of ring, that is used by hook process.
+     *
+     * It is reference implementation, that hook can use directly or re-implement after `ring::Header`.
+     */
+    class RingProducer {
+        private:
+            RingMapping ring;
+
+        public:
+            ///Opens ring created by consumer.
+            ///
+            ///@throws runtime_error When there is no such ring or it is not compatible.
+            explicit RingProducer(const std::string& name);
+
+            ///Writes line if there is free slot.
+            ///
+            ///@return false if ring is full.
+            ///@throws length_error When line doesn't fit into slot.
+            bool try_push(std::string_view line);
+            ///Writes line, waiting for free slot.
+            ///
+            ///@return false if consumer is gone.
+            ///@throws length_error When line doesn't fit into slot.
+            bool push(std::string_view line);
+            ///Tells consumer that there is nothing more.
+            void close() noexcept;
+    };
+}
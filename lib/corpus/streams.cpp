@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "streams.hpp"
+
+using namespace corpus;
+
+///Lines, that can wait for single worker.
+static constexpr size_t QUEUE_SIZE = 1024;
+
+Streams::Worker::Worker() : queue(QUEUE_SIZE) {
+}
+
+Streams::Streams(const text::Cleaner& fallback, Sink&& output, unsigned workers) : fallback(fallback), output(std::move(output)), is_finished(false) {
+    if (workers == 0) workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (unsigned idx = 0; idx < workers; idx++) {
+        this->workers.emplace_back(new Worker());
+    }
+    for (auto& worker : this->workers) {
+        Worker* const target = worker.get();
+        worker->thread = std::thread([this, target]() {
+            this->work(*target);
+        });
+    }
+}
+
+Streams::~Streams() {
+    this->finish();
+}
+
+Streams& Streams::profile(std::string stream, const text::Cleaner& cleaner) {
+    this->profiles[std::move(stream)] = &cleaner;
+    return *this;
+}
+
+void Streams::submit(std::string_view stream, std::string_view line) {
+    //The same stream always goes to the same worker, which keeps its order.
+    const size_t idx = std::hash<std::string_view>()(stream) % this->workers.size();
+    this->workers[idx]->queue.push(Item{std::string(stream), std::string(line)});
+}
+
+void Streams::finish() {
+    if (this->is_finished) return;
+    this->is_finished = true;
+
+    for (auto& worker : this->workers) {
+        Item last;
+        last.is_last = true;
+        worker->queue.push(std::move(last));
+    }
+    for (auto& worker : this->workers) {
+        worker->thread.join();
+    }
+}
+
+void Streams::work(Worker& worker) {
+    for (;;) {
+        Item item = worker.queue.pop();
+        if (item.is_last) return;
+
+        auto iter = worker.streams.find(item.stream);
+        if (iter == worker.streams.end()) {
+            //Profiles are not changed once lines come, so they are read without lock.
+            const auto profile = this->profiles.find(item.stream);
+            Stream stream;
+            stream.cleaner = profile != this->profiles.end() ? profile->second : &this->fallback;
+            iter = worker.streams.emplace(item.stream, std::move(stream)).first;
+        }
+
+        this->output(item.stream, this->clean(iter->second, item.line));
+    }
+}
+
+const std::string& Streams::clean(Stream& stream, const std::string& line) {
+    //Hooks repeat the same lines, like names and menu items, which are not worth cleaning again.
+    for (const auto& entry : stream.cache) {
+        if (entry.first == line) return entry.second;
+    }
+
+    const bool is_crlf = !line.empty() && line.back() == '\r';
+    std::string_view text(line);
+    if (is_crlf) text.remove_suffix(1);
+
+    std::string result;
+    try {
+        const auto cleaned = stream.cleaner->clean(text::to_wide_string(text), stream.state);
+        result = cleaned.has_value() ? text::to_utf8_string(*cleaned) : std::string(text);
+    }
+    catch (const std::range_error&) {
+        result = std::string(text);
+    }
+    //Line end is kept as it was.
+    if (is_crlf) result.push_back('\r');
+
+    if (stream.cache.size() < CACHE_SIZE) {
+        stream.cache.emplace_back(line, std::move(result));
+        return stream.cache.back().second;
+    }
+
+    auto& entry = stream.cache[stream.next_cached];
+    stream.next_cached = (stream.next_cached + 1) % CACHE_SIZE;
+    entry.first = line;
+    entry.second = std::move(result);
+    return entry.second;
+}
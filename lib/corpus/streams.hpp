@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <text/text.hpp>
+
+#include "queue.hpp"
+
+namespace corpus {
+    /**
+     * Cleans several streams of lines at once, like dialogue, names and UI text of the same game.
+     *
+     * Each stream has own profile of rules, incremental state and cache of recent lines.
+     * Stream is owned by single worker, chosen by hash of its ID, so lines of stream are cleaned
+     * in order and its state is never shared. Lines are passed to workers through lock-free queues.
+     *
+     * Lines, that are not valid UTF-8, are passed as they are.
+     */
+    class Streams {
+        public:
+            ///Receives cleaned line of stream, keeping its trailing `\r`.
+            ///
+            ///Called by workers, so lines of different streams can come at once.
+            ///Lines of the same stream come one by one in order of submission.
+            typedef std::function<void(std::string_view stream, std::string_view line)> Sink;
+
+        private:
+            ///Number of recent lines, which result is remembered by stream.
+            static constexpr size_t CACHE_SIZE = 32;
+
+            struct Item {
+                std::string stream;
+                std::string line;
+                ///Whether worker should stop.
+                bool is_last = false;
+            };
+
+            struct Stream {
+                const text::Cleaner* cleaner;
+                text::Cleaner::Incremental state;
+                ///Recent lines with their results, replaced in round robin.
+                std::vector<std::pair<std::string, std::string>> cache;
+                size_t next_cached = 0;
+            };
+
+            struct Worker {
+                Queue<Item> queue;
+                ///Accessed only by thread of worker.
+                std::unordered_map<std::string, Stream> streams;
+                std::thread thread;
+
+                Worker();
+            };
+
+            const text::Cleaner& fallback;
+            std::unordered_map<std::string, const text::Cleaner*> profiles;
+            Sink output;
+            std::vector<std::unique_ptr<Worker>> workers;
+            bool is_finished;
+
+            void work(Worker& worker);
+            ///Cleans line according to stream's state, returning reference to cached result.
+            const std::string& clean(Stream& stream, const std::string& line);
+
+        public:
+            ///Starts workers.
+            ///
+            ///@param fallback Rules of streams, that have no profile of their own. Must outlive Streams.
+            ///@param workers Number of cleaning threads, 0 means number of cores.
+            Streams(const text::Cleaner& fallback, Sink&& output, unsigned workers = 0);
+            ///Finishes cleaning of submitted lines.
+            ~Streams();
+
+            Streams(const Streams&) = delete;
+            Streams& operator=(const Streams&) = delete;
+
+            ///Cleans stream with its own rules. Cleaner must outlive Streams.
+            ///
+            ///Profiles must be set before lines are submitted.
+            Streams& profile(std::string stream, const text::Cleaner& cleaner);
+            ///Queues line of stream for cleaning, waiting if its worker is behind.
+            void submit(std::string_view stream, std::string_view line);
+            ///Waits until every submitted line is cleaned and stops workers.
+            void finish();
+    };
+}
@@ -0,0 +1,408 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "broadcast.hpp"
+#include "socket.hpp"
+
+using namespace service;
+
+///Tokens of epoll events, that are not subscribers.
+static constexpr uint64_t WAKE_TOKEN = 0;
+static constexpr uint64_t UNIX_TOKEN = 1;
+static constexpr uint64_t WEBSOCKET_TOKEN = 2;
+static constexpr uint64_t FIRST_SUBSCRIBER = 3;
+
+static constexpr int MAX_EVENTS = 256;
+///Parts of messages written at once.
+static constexpr size_t MAX_PARTS = 64;
+///Subscribers only send handshake and control frames, so anything bigger is abuse.
+static constexpr size_t MAX_INPUT = 16 * 1024;
+
+static std::runtime_error system_error(const std::string& message) {
+    return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+Broadcaster::Broadcaster(const BroadcastOptions& options) : options(options), epoll(-1), wake(-1), unix_listener(-1), websocket_listener(-1), websocket_port(0), is_stopped(false), subscriber_count(0), dropped(0), next_subscriber(FIRST_SUBSCRIBER) {
+    try {
+        this->epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (this->epoll == -1) throw system_error("Cannot create epoll");
+        this->wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (this->wake == -1) throw system_error("Cannot create eventfd");
+        watch(this->epoll, this->wake, EPOLLIN, WAKE_TOKEN);
+
+        if (!options.socket_path.empty()) {
+            this->unix_listener = listen_unix(options.socket_path);
+            watch(this->epoll, this->unix_listener, EPOLLIN, UNIX_TOKEN);
+        }
+
+        if (options.websocket_port.has_value()) {
+            this->websocket_port = *options.websocket_port;
+            this->websocket_listener = listen_tcp(this->websocket_port);
+            watch(this->epoll, this->websocket_listener, EPOLLIN, WEBSOCKET_TOKEN);
+        }
+
+        if (this->unix_listener == -1 && this->websocket_listener == -1) throw std::runtime_error("There is nothing to listen on");
+    }
+    catch (...) {
+        this->shutdown();
+        throw;
+    }
+
+    this->loop = std::thread([this]() {
+        this->run();
+    });
+}
+
+Broadcaster::~Broadcaster() {
+    this->is_stopped.store(true);
+    const uint64_t value = 1;
+    [[maybe_unused]] const auto result = ::write(this->wake, &value, sizeof(value));
+    this->loop.join();
+
+    for (const auto& subscriber : this->subscribers) {
+        ::close(subscriber.second.handle);
+    }
+    this->shutdown();
+}
+
+void Broadcaster::shutdown() noexcept {
+    if (this->unix_listener != -1) {
+        ::close(this->unix_listener);
+        unlink(this->options.socket_path.c_str());
+    }
+    if (this->websocket_listener != -1) ::close(this->websocket_listener);
+    if (this->wake != -1) ::close(this->wake);
+    if (this->epoll != -1) ::close(this->epoll);
+}
+
+void Broadcaster::publish(std::string_view line) {
+    //Publisher runs on cleaning threads, which have no use for error of single line.
+    if (line.size() > MAX_MESSAGE) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto message = std::make_shared<Message>();
+    message->payload.assign(line);
+    const auto size = static_cast<uint32_t>(line.size());
+    for (size_t idx = 0; idx < HEADER_SIZE; idx++) {
+        message->header[idx] = static_cast<char>((size >> (idx * 8)) & 0xFF);
+    }
+    message->websocket_header_size = websocket::text_header(line.size(), message->websocket_header);
+    message->is_raw = false;
+
+    bool is_first = false;
+    {
+        const std::lock_guard<std::mutex> guard(this->published_lock);
+        is_first = this->published.empty();
+        this->published.push_back(std::move(message));
+    }
+    //Loop takes all published lines at once, so it is woken only by the first of them.
+    if (is_first) {
+        const uint64_t value = 1;
+        [[maybe_unused]] const auto result = ::write(this->wake, &value, sizeof(value));
+    }
+}
+
+size_t Broadcaster::subscribers_size() const noexcept {
+    return this->subscriber_count.load();
+}
+
+uint64_t Broadcaster::dropped_count() const noexcept {
+    return this->dropped.load(std::memory_order_relaxed);
+}
+
+std::optional<uint16_t> Broadcaster::port() const noexcept {
+    if (this->websocket_listener == -1) return std::nullopt;
+    return this->websocket_port;
+}
+
+///@return Header of message in framing of subscriber.
+static std::string_view header_of(bool is_websocket, const char* header, const char* websocket_header, size_t websocket_header_size) noexcept {
+    if (is_websocket) return std::string_view(websocket_header, websocket_header_size);
+    return std::string_view(header, HEADER_SIZE);
+}
+
+void Broadcaster::run() {
+    epoll_event events[MAX_EVENTS];
+    std::vector<std::shared_ptr<const Message>> taken;
+    std::vector<uint64_t> ready;
+
+    while (!this->is_stopped.load()) {
+        const int count = epoll_wait(this->epoll, events, MAX_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            //Nothing to do without epoll, but publishers should not notice it.
+            return;
+        }
+
+        for (int idx = 0; idx < count; idx++) {
+            const uint64_t token = events[idx].data.u64;
+            const uint32_t flags = events[idx].events;
+
+            if (token == WAKE_TOKEN) {
+                uint64_t value = 0;
+                [[maybe_unused]] const auto result = ::read(this->wake, &value, sizeof(value));
+
+                taken.clear();
+                {
+                    const std::lock_guard<std::mutex> guard(this->published_lock);
+                    taken.swap(this->published);
+                }
+                if (taken.empty()) continue;
+                this->last = taken.back();
+
+                ready.clear();
+                for (auto iter = this->subscribers.begin(); iter != this->subscribers.end();) {
+                    auto& subscriber = iter->second;
+                    //Handshake is not done yet, so it will get the last line once it is.
+                    if (subscriber.kind == Kind::Handshake) {
+                        ++iter;
+                        continue;
+                    }
+
+                    bool is_ok = true;
+                    for (const auto& message : taken) {
+                        is_ok = this->enqueue(subscriber, message);
+                        if (!is_ok) break;
+                    }
+                    if (!is_ok) {
+                        ::close(subscriber.handle);
+                        iter = this->subscribers.erase(iter);
+                        this->subscriber_count.fetch_sub(1);
+                        continue;
+                    }
+
+                    //Subscriber waiting for its socket to drain has nothing to write now anyway.
+                    if ((subscriber.events & EPOLLOUT) == 0) ready.push_back(iter->first);
+                    ++iter;
+                }
+
+                for (const auto id : ready) {
+                    this->flush(id, this->subscribers.at(id));
+                }
+                continue;
+            }
+            else if (token == UNIX_TOKEN) {
+                this->accept(this->unix_listener, Kind::Raw);
+                continue;
+            }
+            else if (token == WEBSOCKET_TOKEN) {
+                this->accept(this->websocket_listener, Kind::Handshake);
+                continue;
+            }
+
+            auto iter = this->subscribers.find(token);
+            if (iter == this->subscribers.end()) continue;
+            if ((flags & (EPOLLERR | EPOLLHUP)) != 0) {
+                this->close(token);
+                continue;
+            }
+
+            if ((flags & EPOLLIN) != 0) {
+                this->read(token, iter->second);
+                iter = this->subscribers.find(token);
+                if (iter == this->subscribers.end()) continue;
+            }
+            if ((flags & EPOLLOUT) != 0) {
+                this->flush(token, iter->second);
+            }
+        }
+    }
+}
+
+void Broadcaster::accept(int listener, Kind kind) {
+    for (;;) {
+        const int handle = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (handle == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;
+        }
+
+        if (kind != Kind::Raw) {
+            const int enable = 1;
+            setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        const uint64_t id = this->next_subscriber++;
+        try {
+            watch(this->epoll, handle, EPOLLIN, id);
+        }
+        catch (const std::runtime_error&) {
+            ::close(handle);
+            continue;
+        }
+
+        auto& subscriber = this->subscribers[id];
+        subscriber.handle = handle;
+        subscriber.kind = kind;
+        subscriber.events = EPOLLIN;
+        this->subscriber_count.fetch_add(1);
+
+        if (kind == Kind::Raw && this->last) {
+            this->enqueue(subscriber, this->last);
+            this->flush(id, subscriber);
+        }
+    }
+}
+
+void Broadcaster::read(uint64_t id, Subscriber& subscriber) {
+    char buffer[4096];
+    ssize_t count;
+    do {
+        count = ::read(subscriber.handle, buffer, sizeof(buffer));
+    } while (count == -1 && errno == EINTR);
+
+    if (count == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (count <= 0) {
+        this->close(id);
+        return;
+    }
+
+    //Raw subscribers only listen.
+    if (subscriber.kind == Kind::Raw) return;
+
+    subscriber.input.append(buffer, static_cast<size_t>(count));
+    if (subscriber.input.size() > MAX_INPUT) {
+        this->close(id);
+        return;
+    }
+
+    if (subscriber.kind == Kind::Handshake) {
+        const size_t end = subscriber.input.find("\r\n\r\n");
+        if (end == std::string::npos) return;
+
+        const auto key = websocket::key(std::string_view(subscriber.input).substr(0, end));
+        if (key.empty()) {
+            this->close(id);
+            return;
+        }
+
+        auto response = std::make_shared<Message>();
+        response->payload = websocket::accept(key);
+        response->websocket_header_size = 0;
+        response->is_raw = true;
+
+        subscriber.kind = Kind::WebSocket;
+        subscriber.input.erase(0, end + 4);
+        this->enqueue(subscriber, response);
+        if (this->last) this->enqueue(subscriber, this->last);
+        this->flush(id, subscriber);
+        return;
+    }
+
+    for (;;) {
+        size_t size = 0;
+        const auto frame = websocket::parse(subscriber.input, size);
+        if (frame == websocket::Frame::Incomplete) return;
+        if (frame == websocket::Frame::Close) {
+            this->close(id);
+            return;
+        }
+        subscriber.input.erase(0, size);
+    }
+}
+
+///@return Size of message in framing of subscriber.
+static size_t framed_size(bool is_websocket, bool is_raw, size_t payload_size, size_t websocket_header_size) noexcept {
+    if (is_raw) return payload_size;
+    return payload_size + (is_websocket ? websocket_header_size : HEADER_SIZE);
+}
+
+bool Broadcaster::enqueue(Subscriber& subscriber, const std::shared_ptr<const Message>& message) {
+    const bool is_websocket = subscriber.kind == Kind::WebSocket;
+    const auto size_of = [is_websocket](const Message& message) {
+        return framed_size(is_websocket, message.is_raw, message.payload.size(), message.websocket_header_size);
+    };
+
+    subscriber.queue.push_back(message);
+    subscriber.pending += size_of(*message);
+    if (subscriber.pending <= this->options.max_pending) return true;
+    if (this->options.overflow == Overflow::Disconnect) return false;
+
+    //Partially written message and handshake cannot be dropped, the newest line is always kept.
+    size_t idx = subscriber.offset > 0 ? 1 : 0;
+    while (subscriber.pending > this->options.max_pending && idx + 1 < subscriber.queue.size()) {
+        const auto& oldest = *subscriber.queue[idx];
+        if (oldest.is_raw) {
+            idx += 1;
+            continue;
+        }
+        subscriber.pending -= size_of(oldest);
+        subscriber.queue.erase(subscriber.queue.begin() + static_cast<std::ptrdiff_t>(idx));
+    }
+    return true;
+}
+
+void Broadcaster::flush(uint64_t id, Subscriber& subscriber) {
+    const bool is_websocket = subscriber.kind == Kind::WebSocket;
+
+    while (!subscriber.queue.empty()) {
+        iovec parts[MAX_PARTS];
+        size_t count = 0;
+        size_t skip = subscriber.offset;
+        const auto add = [&parts, &count, &skip](std::string_view data) {
+            if (skip >= data.size()) {
+                skip -= data.size();
+                return;
+            }
+            parts[count].iov_base = const_cast<char*>(data.data() + skip);
+            parts[count].iov_len = data.size() - skip;
+            count += 1;
+            skip = 0;
+        };
+
+        for (const auto& message : subscriber.queue) {
+            if (count + 2 > MAX_PARTS) break;
+            if (!message->is_raw) add(header_of(is_websocket, message->header, message->websocket_header, message->websocket_header_size));
+            add(message->payload);
+        }
+
+        msghdr header = {};
+        header.msg_iov = parts;
+        header.msg_iovlen = count;
+        const ssize_t written = sendmsg(subscriber.handle, &header, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            this->close(id);
+            return;
+        }
+
+        subscriber.pending -= static_cast<size_t>(written);
+        subscriber.offset += static_cast<size_t>(written);
+        while (!subscriber.queue.empty()) {
+            const auto& front = *subscriber.queue.front();
+            const size_t size = framed_size(is_websocket, front.is_raw, front.payload.size(), front.websocket_header_size);
+            if (subscriber.offset < size) break;
+
+            subscriber.offset -= size;
+            subscriber.queue.pop_front();
+        }
+    }
+
+    uint32_t events = EPOLLIN;
+    if (!subscriber.queue.empty()) events |= EPOLLOUT;
+    if (events != subscriber.events) {
+        rewatch(this->epoll, subscriber.handle, events, id);
+        subscriber.events = events;
+    }
+}
+
+void Broadcaster::close(uint64_t id) {
+    const auto iter = this->subscribers.find(id);
+    if (iter == this->subscribers.end()) return;
+
+    ::close(iter->second.handle);
+    this->subscribers.erase(iter);
+    this->subscriber_count.fetch_sub(1);
+}
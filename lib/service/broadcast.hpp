@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "protocol.hpp"
+#include "websocket.hpp"
+
+namespace service {
+    enum class Overflow {
+        ///Subscriber, that cannot keep up, is disconnected.
+        Disconnect,
+        ///Oldest lines, that subscriber has not started to receive, are dropped.
+        Skip,
+    };
+
+    struct BroadcastOptions {
+        ///Path of Unix domain socket for subscribers, that receive lines as messages of service protocol. None if empty.
+        std::string socket_path;
+        ///Port on localhost for WebSocket subscribers, 0 picks any free one. None if not set.
+        std::optional<uint16_t> websocket_port;
+        ///Bytes, that can wait for single subscriber, before it is considered slow.
+        size_t max_pending = 1024 * 1024;
+        Overflow overflow = Overflow::Disconnect;
+    };
+
+    /**
+     * Pushes cleaned lines to subscribers in real time.
+     *
+     * Each line is stored once in immutable shared buffer, which is written to every subscriber from its own queue,
+     * so there are no copies per subscriber. Sockets are served by own thread, so publisher only hands line over.
+     *
+     * New subscriber receives the last line at once, so that overlay can show current text.
+     */
+    class Broadcaster {
+        private:
+            ///Line with headers of both framings.
+            struct Message {
+                std::string payload;
+                char header[HEADER_SIZE];
+                char websocket_header[websocket::MAX_HEADER];
+                size_t websocket_header_size;
+                ///Whether payload is sent as it is, like handshake response.
+                bool is_raw;
+            };
+
+            enum class Kind {
+                Raw,
+                Handshake,
+                WebSocket,
+            };
+
+            struct Subscriber {
+                int handle;
+                Kind kind;
+                ///Received bytes, that are not processed yet.
+                std::string input;
+                std::deque<std::shared_ptr<const Message>> queue;
+                ///Bytes of the first message, that are already written.
+                size_t offset = 0;
+                ///Bytes in queue, that are not written yet.
+                size_t pending = 0;
+                uint32_t events = 0;
+            };
+
+            BroadcastOptions options;
+            int epoll;
+            int wake;
+            int unix_listener;
+            int websocket_listener;
+            uint16_t websocket_port;
+            std::atomic<bool> is_stopped;
+            std::atomic<size_t> subscriber_count;
+            std::atomic<uint64_t> dropped;
+
+            std::mutex published_lock;
+            std::vector<std::shared_ptr<const Message>> published;
+            std::shared_ptr<const Message> last;
+
+            std::unordered_map<uint64_t, Subscriber> subscribers;
+            uint64_t next_subscriber;
+            std::thread loop;
+
+            void run();
+            void accept(int listener, Kind kind);
+            void read(uint64_t id, Subscriber& subscriber);
+            ///Queues message, applying overflow policy.
+            ///
+            ///@return false if subscriber is disconnected.
+            bool enqueue(Subscriber& subscriber, const std::shared_ptr<const Message>& message);
+            ///Writes what it can and updates events of subscriber.
+            void flush(uint64_t id, Subscriber& subscriber);
+            void close(uint64_t id);
+            void shutdown() noexcept;
+
+        public:
+            ///Starts listening in own thread.
+            ///
+            ///@throws runtime_error When socket cannot be set up.
+            explicit Broadcaster(const BroadcastOptions& options);
+            ///Disconnects all subscribers and removes Unix domain socket.
+            ~Broadcaster();
+
+            Broadcaster(const Broadcaster&) = delete;
+            Broadcaster& operator=(const Broadcaster&) = delete;
+
+            ///Sends line to every subscriber. Can be called from any thread.
+            ///
+            ///Line is only handed over, so it never waits for subscribers.
+            ///Line bigger than `MAX_MESSAGE` is dropped, as subscribers cannot receive it.
+            void publish(std::string_view line);
+            ///@return Number of connected subscribers.
+            size_t subscribers_size() const noexcept;
+            ///@return Number of lines, that were dropped as too big.
+            uint64_t dropped_count() const noexcept;
+            ///@return Actual WebSocket port, if listening on it.
+            std::optional<uint16_t> port() const noexcept;
+    };
+}
@@ -0,0 +1,95 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.hpp"
+#include "protocol.hpp"
+
+using namespace service;
+
+int service::connect_unix(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long: " + path);
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int handle = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (handle == -1 || connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+        const auto reason = std::string(std::strerror(errno));
+        if (handle != -1) close(handle);
+        throw std::runtime_error("Cannot connect to " + path + ": " + reason);
+    }
+
+    return handle;
+}
+
+int service::connect_tcp(uint16_t port) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    const int handle = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (handle == -1 || connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1) {
+        const auto reason = std::string(std::strerror(errno));
+        if (handle != -1) close(handle);
+        throw std::runtime_error("Cannot connect to port " + std::to_string(port) + ": " + reason);
+    }
+
+    const int enable = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return handle;
+}
+
+Client::Client(int handle) noexcept : handle(handle) {
+}
+
+Client::~Client() {
+    close(this->handle);
+}
+
+void Client::send(std::string_view text) {
+    std::string message;
+    encode(text, message);
+
+    for (size_t written = 0; written < message.size();) {
+        const ssize_t count = ::send(this->handle, message.data() + written, message.size() - written, MSG_NOSIGNAL);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Failed to send request: ") + std::strerror(errno));
+        }
+        written += static_cast<size_t>(count);
+    }
+}
+
+std::string Client::receive() {
+    char buffer[64 * 1024];
+    for (;;) {
+        std::string_view text;
+        const size_t size = decode(this->input, text);
+        if (size > 0) {
+            std::string result(text);
+            this->input.erase(0, size);
+            return result;
+        }
+
+        const ssize_t count = ::read(this->handle, buffer, sizeof(buffer));
+        if (count == 0) throw std::runtime_error("Connection is closed");
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("Failed to receive response: ") + std::strerror(errno));
+        }
+        this->input.append(buffer, static_cast<size_t>(count));
+    }
+}
+
+void Client::finish() noexcept {
+    shutdown(this->handle, SHUT_WR);
+}
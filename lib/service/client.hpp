@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace service {
+    ///Connects to Unix domain socket.
+    ///
+    ///@return Blocking socket.
+    ///@throws runtime_error When connection fails.
+    int connect_unix(const std::string& path);
+    ///Connects to port on localhost.
+    ///
+    ///@return Blocking socket.
+    ///@throws runtime_error When connection fails.
+    int connect_tcp(uint16_t port);
+
+    /**
+     * Blocking client of cleaning service.
+     */
+    class Client {
+        private:
+            int handle;
+            ///Received bytes, that are not yet whole response.
+            std::string input;
+
+        public:
+            ///Takes ownership of connected socket.
+            explicit Client(int handle) noexcept;
+            ~Client();
+
+            Client(const Client&) = delete;
+            Client& operator=(const Client&) = delete;
+
+            ///Sends request without waiting for response.
+            ///
+            ///@throws runtime_error When connection is broken.
+            void send(std::string_view text);
+            ///Waits for response to the oldest request.
+            ///
+            ///@throws runtime_error When connection is closed.
+            std::string receive();
+            ///Finishes sending, so that server closes connection after the last response.
+            void finish() noexcept;
+
+            ///@return Cleaned text.
+            std::string clean(std::string_view text) {
+                this->send(text);
+                return this->receive();
+            }
+    };
+}
@@ -0,0 +1,27 @@
+#include <stdexcept>
+
+#include "protocol.hpp"
+
+void service::encode(std::string_view text, std::string& buffer) {
+    if (text.size() > MAX_MESSAGE) throw std::length_error("Message is too big");
+
+    const auto size = static_cast<uint32_t>(text.size());
+    for (size_t idx = 0; idx < HEADER_SIZE; idx++) {
+        buffer.push_back(static_cast<char>((size >> (idx * 8)) & 0xFF));
+    }
+    buffer.append(text);
+}
+
+size_t service::decode(std::string_view buffer, std::string_view& text) {
+    if (buffer.size() < HEADER_SIZE) return 0;
+
+    uint32_t size = 0;
+    for (size_t idx = 0; idx < HEADER_SIZE; idx++) {
+        size |= static_cast<uint32_t>(static_cast<unsigned char>(buffer[idx])) << (idx * 8);
+    }
+    if (size > MAX_MESSAGE) throw std::length_error("Message is too big");
+    if (buffer.size() - HEADER_SIZE < size) return 0;
+
+    text = buffer.substr(HEADER_SIZE, size);
+    return HEADER_SIZE + size;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Protocol of cleaning service.
+ *
+ * Request and response are both message: 32-bit little-endian size followed by UTF-8 text.
+ * Each request gets exactly one response with cleaned text (or the same text if there is nothing to clean).
+ * Client may send several requests without waiting, responses come in the same order.
+ */
+namespace service {
+    static constexpr size_t HEADER_SIZE = sizeof(uint32_t);
+    ///Connection, that sends bigger message, is closed.
+    static constexpr uint32_t MAX_MESSAGE = 16 * 1024 * 1024;
+
+    ///Appends message with text to buffer.
+    void encode(std::string_view text, std::string& buffer);
+
+    ///Extracts message from start of buffer.
+    ///
+    ///@param text Receives text of message, if it is complete.
+    ///@return Size of whole message, 0 if it is incomplete.
+    ///@throws length_error When message is bigger than `MAX_MESSAGE`.
+    size_t decode(std::string_view buffer, std::string_view& text);
+}
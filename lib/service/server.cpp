@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "protocol.hpp"
+#include "server.hpp"
+#include "socket.hpp"
+
+using namespace service;
+
+///Tokens of epoll events, that are not connections.
+static constexpr uint64_t WAKE_TOKEN = 0;
+static constexpr uint64_t UNIX_TOKEN = 1;
+static constexpr uint64_t TCP_TOKEN = 2;
+static constexpr uint64_t FIRST_CONNECTION = 3;
+
+///Requests of single connection, that can be cleaned at once.
+///
+///Once reached, connection is not read until some are done, so that single client cannot take all memory.
+static constexpr size_t MAX_IN_FLIGHT = 64;
+///Size of single read, connection is read once per event to be fair to others.
+static constexpr size_t READ_SIZE = 64 * 1024;
+static constexpr int MAX_EVENTS = 256;
+
+static std::runtime_error system_error(const std::string& message) {
+    return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+///Cleans text in place, leaving it as it is, if it is not valid UTF-8.
+static void clean_text(std::string& text, const text::Cleaner& cleaner) {
+    try {
+        const auto cleaned = cleaner.clean(text::to_wide_string(text));
+        if (cleaned.has_value()) text = text::to_utf8_string(*cleaned);
+    }
+    catch (const std::range_error&) {
+    }
+}
+
+Server::Server(const text::Cleaner& cleaner, const Options& options) : cleaner(cleaner), socket_path(options.socket_path), epoll(-1), wake(-1), unix_listener(-1), tcp_listener(-1), tcp_port(0), is_stopped(false), next_connection(FIRST_CONNECTION) {
+    try {
+        this->epoll = epoll_create1(EPOLL_CLOEXEC);
+        if (this->epoll == -1) throw system_error("Cannot create epoll");
+        this->wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (this->wake == -1) throw system_error("Cannot create eventfd");
+        watch(this->epoll, this->wake, EPOLLIN, WAKE_TOKEN);
+
+        if (!this->socket_path.empty()) {
+            this->unix_listener = listen_unix(this->socket_path);
+            watch(this->epoll, this->unix_listener, EPOLLIN, UNIX_TOKEN);
+        }
+
+        if (options.tcp_port.has_value()) {
+            this->tcp_port = *options.tcp_port;
+            this->tcp_listener = listen_tcp(this->tcp_port);
+            watch(this->epoll, this->tcp_listener, EPOLLIN, TCP_TOKEN);
+        }
+
+        if (this->unix_listener == -1 && this->tcp_listener == -1) throw std::runtime_error("There is nothing to listen on");
+    }
+    catch (...) {
+        this->shutdown();
+        throw;
+    }
+
+    unsigned count = options.workers;
+    if (count == 0) count = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned idx = 0; idx < count; idx++) {
+        this->workers.emplace_back([this]() {
+            this->work();
+        });
+    }
+}
+
+Server::~Server() {
+    this->stop();
+    {
+        const std::lock_guard<std::mutex> guard(this->jobs_lock);
+        this->jobs_ready.notify_all();
+    }
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+
+    for (const auto& connection : this->connections) {
+        ::close(connection.second.handle);
+    }
+    this->shutdown();
+}
+
+void Server::shutdown() noexcept {
+    if (this->unix_listener != -1) {
+        ::close(this->unix_listener);
+        unlink(this->socket_path.c_str());
+    }
+    if (this->tcp_listener != -1) ::close(this->tcp_listener);
+    if (this->wake != -1) ::close(this->wake);
+    if (this->epoll != -1) ::close(this->epoll);
+}
+
+void Server::work() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> guard(this->jobs_lock);
+            this->jobs_ready.wait(guard, [this]() {
+                return !this->jobs.empty() || this->is_stopped.load();
+            });
+            if (this->is_stopped.load()) return;
+
+            job = std::move(this->jobs.front());
+            this->jobs.pop_front();
+        }
+
+        clean_text(job.text, this->cleaner);
+
+        bool is_first = false;
+        {
+            const std::lock_guard<std::mutex> guard(this->done_lock);
+            is_first = this->done.empty();
+            this->done.push_back(std::move(job));
+        }
+        //Loop collects all finished jobs at once, so it is woken only by the first of them.
+        if (is_first) {
+            const uint64_t value = 1;
+            [[maybe_unused]] const auto result = ::write(this->wake, &value, sizeof(value));
+        }
+    }
+}
+
+void Server::accept(int listener) {
+    for (;;) {
+        const int handle = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (handle == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            //Either there is nothing more, or out of descriptors, in which case it is retried on the next event.
+            return;
+        }
+
+        if (listener == this->tcp_listener) {
+            //Responses are small and latency matters.
+            const int enable = 1;
+            setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+
+        const uint64_t id = this->next_connection++;
+        try {
+            watch(this->epoll, handle, EPOLLIN, id);
+        }
+        catch (const std::runtime_error&) {
+            ::close(handle);
+            continue;
+        }
+
+        auto& connection = this->connections[id];
+        connection.handle = handle;
+        connection.events = EPOLLIN;
+    }
+}
+
+bool Server::read(Connection& connection) {
+    char buffer[READ_SIZE];
+    for (;;) {
+        const ssize_t count = ::read(connection.handle, buffer, sizeof(buffer));
+        if (count > 0) {
+            connection.input.append(buffer, static_cast<size_t>(count));
+            return true;
+        }
+        if (count == 0) {
+            connection.is_closing = true;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+void Server::parse(uint64_t id, Connection& connection) {
+    std::vector<Job> parsed;
+    size_t offset = 0;
+    while (connection.in_flight() + parsed.size() < MAX_IN_FLIGHT) {
+        std::string_view text;
+        const size_t size = decode(std::string_view(connection.input).substr(offset), text);
+        if (size == 0) break;
+
+        parsed.push_back(Job{id, connection.next_request + parsed.size(), std::string(text)});
+        offset += size;
+    }
+    if (parsed.empty()) return;
+
+    connection.input.erase(0, offset);
+    connection.next_request += parsed.size();
+    {
+        const std::lock_guard<std::mutex> guard(this->jobs_lock);
+        for (auto& job : parsed) {
+            this->jobs.push_back(std::move(job));
+        }
+    }
+    if (parsed.size() == 1) this->jobs_ready.notify_one();
+    else this->jobs_ready.notify_all();
+}
+
+void Server::collect() {
+    std::vector<Job> finished;
+    {
+        const std::lock_guard<std::mutex> guard(this->done_lock);
+        finished.swap(this->done);
+    }
+
+    std::vector<uint64_t> touched;
+    for (auto& job : finished) {
+        //Connection might be closed while its request was cleaned.
+        const auto iter = this->connections.find(job.connection);
+        if (iter == this->connections.end()) continue;
+
+        iter->second.done.emplace(job.seq, std::move(job.text));
+        touched.push_back(job.connection);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    for (const auto id : touched) {
+        auto& connection = this->connections.at(id);
+        try {
+            auto& done = connection.done;
+            for (auto iter = done.begin(); iter != done.end() && iter->first == connection.next_response; iter = done.erase(iter)) {
+                encode(iter->second, connection.output);
+                connection.next_response += 1;
+            }
+            //Requests, that were held back by limit.
+            this->parse(id, connection);
+        }
+        catch (const std::length_error&) {
+            this->close(id);
+            continue;
+        }
+        this->flush(id, connection);
+    }
+}
+
+void Server::flush(uint64_t id, Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        const ssize_t count = send(connection.handle, connection.output.data() + written, connection.output.size() - written, MSG_NOSIGNAL);
+        if (count >= 0) {
+            written += static_cast<size_t>(count);
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+
+        this->close(id);
+        return;
+    }
+    connection.output.erase(0, written);
+
+    if (connection.is_closing && connection.in_flight() == 0 && connection.output.empty()) {
+        this->close(id);
+        return;
+    }
+
+    uint32_t events = 0;
+    if (!connection.is_closing && connection.in_flight() < MAX_IN_FLIGHT) events |= EPOLLIN;
+    if (!connection.output.empty()) events |= EPOLLOUT;
+    if (events != connection.events) {
+        rewatch(this->epoll, connection.handle, events, id);
+        connection.events = events;
+    }
+}
+
+void Server::close(uint64_t id) {
+    const auto iter = this->connections.find(id);
+    if (iter == this->connections.end()) return;
+
+    //Closed descriptor is removed from epoll on its own.
+    ::close(iter->second.handle);
+    this->connections.erase(iter);
+}
+
+void Server::run() {
+    epoll_event events[MAX_EVENTS];
+
+    while (!this->is_stopped.load()) {
+        const int count = epoll_wait(this->epoll, events, MAX_EVENTS, -1);
+        if (count == -1) {
+            if (errno == EINTR) continue;
+            throw system_error("Failed to wait for connections");
+        }
+
+        for (int idx = 0; idx < count; idx++) {
+            const uint64_t token = events[idx].data.u64;
+            const uint32_t flags = events[idx].events;
+
+            if (token == WAKE_TOKEN) {
+                uint64_t value = 0;
+                [[maybe_unused]] const auto result = ::read(this->wake, &value, sizeof(value));
+                this->collect();
+                continue;
+            }
+            else if (token == UNIX_TOKEN) {
+                this->accept(this->unix_listener);
+                continue;
+            }
+            else if (token == TCP_TOKEN) {
+                this->accept(this->tcp_listener);
+                continue;
+            }
+
+            const auto iter = this->connections.find(token);
+            if (iter == this->connections.end()) continue;
+            auto& connection = iter->second;
+
+            //Peer is gone completely, so there is no one to respond to.
+            if ((flags & (EPOLLERR | EPOLLHUP)) != 0) {
+                this->close(token);
+                continue;
+            }
+
+            if ((flags & EPOLLIN) != 0) {
+                try {
+                    if (!this->read(connection)) {
+                        this->close(token);
+                        continue;
+                    }
+                    this->parse(token, connection);
+                }
+                catch (const std::length_error&) {
+                    this->close(token);
+                    continue;
+                }
+            }
+
+            this->flush(token, connection);
+        }
+    }
+}
+
+void Server::stop() noexcept {
+    this->is_stopped.store(true);
+    if (this->wake != -1) {
+        const uint64_t value = 1;
+        [[maybe_unused]] const auto result = ::write(this->wake, &value, sizeof(value));
+    }
+}
+
+std::optional<uint16_t> Server::port() const noexcept {
+    if (this->tcp_listener == -1) return std::nullopt;
+    return this->tcp_port;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <text/text.hpp>
+
+namespace service {
+    struct Options {
+        ///Path of Unix domain socket, none if empty.
+        std::string socket_path;
+        ///Port on localhost, 0 picks any free one. None if not set.
+        std::optional<uint16_t> tcp_port;
+        ///Number of cleaning threads, 0 means number of cores.
+        unsigned workers = 0;
+    };
+
+    /**
+     * Cleaning service for local tools, so that they all share the same rules.
+     *
+     * Single event loop thread multiplexes all connections with epoll, reading requests and writing responses
+     * without blocking. Requests are cleaned by pool of workers with one shared `Cleaner`.
+     */
+    class Server {
+        private:
+            ///Text to clean, that is replaced with cleaned one by worker.
+            struct Job {
+                uint64_t connection;
+                uint64_t seq;
+                std::string text;
+            };
+
+            struct Connection {
+                int handle;
+                ///Received bytes, that are not yet whole request.
+                std::string input;
+                ///Encoded responses, that are not yet written.
+                std::string output;
+                ///Sequence number of the next request.
+                uint64_t next_request = 0;
+                ///Sequence number of the next response to write.
+                uint64_t next_response = 0;
+                ///Responses, that are done before preceding ones.
+                std::map<uint64_t, std::string> done;
+                ///Whether peer has finished sending.
+                bool is_closing = false;
+                ///Events, which connection is registered for.
+                uint32_t events = 0;
+
+                size_t in_flight() const noexcept {
+                    return static_cast<size_t>(this->next_request - this->next_response);
+                }
+            };
+
+            const text::Cleaner& cleaner;
+            std::string socket_path;
+            int epoll;
+            int wake;
+            int unix_listener;
+            int tcp_listener;
+            uint16_t tcp_port;
+            std::atomic<bool> is_stopped;
+
+            std::mutex jobs_lock;
+            std::condition_variable jobs_ready;
+            std::deque<Job> jobs;
+            std::mutex done_lock;
+            std::vector<Job> done;
+            std::vector<std::thread> workers;
+
+            std::unordered_map<uint64_t, Connection> connections;
+            uint64_t next_connection;
+
+            void work();
+            void accept(int listener);
+            ///@return false if connection is broken.
+            bool read(Connection& connection);
+            ///Turns complete requests into jobs, as long as connection is within its limit.
+            ///
+            ///@throws length_error When request is too big.
+            void parse(uint64_t id, Connection& connection);
+            ///Moves finished jobs into their connections.
+            void collect();
+            ///Writes what it can and updates events of connection, closing it once it is done.
+            void flush(uint64_t id, Connection& connection);
+            void close(uint64_t id);
+            void shutdown() noexcept;
+
+        public:
+            ///Starts listening and workers.
+            ///
+            ///@throws runtime_error When socket cannot be set up.
+            Server(const text::Cleaner& cleaner, const Options& options);
+            ///Closes all connections and removes Unix domain socket.
+            ~Server();
+
+            Server(const Server&) = delete;
+            Server& operator=(const Server&) = delete;
+
+            ///Serves connections until stopped.
+            void run();
+            ///Makes `run` return. Can be called from any thread.
+            void stop() noexcept;
+            ///@return Actual TCP port, if listening on it.
+            std::optional<uint16_t> port() const noexcept;
+    };
+}
@@ -0,0 +1,74 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "socket.hpp"
+
+static std::runtime_error system_error(const std::string& message) {
+    return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+int service::listen_unix(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw std::runtime_error("Socket path is too long: " + path);
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) unlink(path.c_str());
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener == -1) throw system_error("Cannot create socket");
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1) {
+        const auto error = system_error("Cannot listen on " + path);
+        close(listener);
+        throw error;
+    }
+
+    return listener;
+}
+
+int service::listen_tcp(uint16_t& port) {
+    const int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener == -1) throw system_error("Cannot create socket");
+
+    const int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1) {
+        const auto error = system_error("Cannot listen on port " + std::to_string(port));
+        close(listener);
+        throw error;
+    }
+
+    socklen_t size = sizeof(address);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &size);
+    port = ntohs(address.sin_port);
+    return listener;
+}
+
+void service::watch(int epoll, int handle, uint32_t events, uint64_t token) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = token;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, handle, &event) == -1) throw system_error("Cannot watch socket");
+}
+
+void service::rewatch(int epoll, int handle, uint32_t events, uint64_t token) noexcept {
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = token;
+    epoll_ctl(epoll, EPOLL_CTL_MOD, handle, &event);
+}
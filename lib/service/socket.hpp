@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+///Socket helpers shared by servers of service.
+namespace service {
+    ///Listens on Unix domain socket, replacing socket left by server, that has not exited cleanly.
+    ///
+    ///@return Non-blocking listener.
+    ///@throws runtime_error When socket cannot be set up.
+    int listen_unix(const std::string& path);
+    ///Listens on port of localhost.
+    ///
+    ///@param port Port, 0 picks any free one and receives it.
+    ///@return Non-blocking listener.
+    ///@throws runtime_error When socket cannot be set up.
+    int listen_tcp(uint16_t& port);
+    ///Registers socket in epoll.
+    ///
+    ///@throws runtime_error When epoll fails.
+    void watch(int epoll, int handle, uint32_t events, uint64_t token);
+    ///Changes events of socket in epoll.
+    void rewatch(int epoll, int handle, uint32_t events, uint64_t token) noexcept;
+}
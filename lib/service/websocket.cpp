@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+#include "websocket.hpp"
+
+using namespace service;
+
+///Appended to key of client to prove that server speaks WebSocket.
+static constexpr std::string_view GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static inline uint32_t rotate(uint32_t value, unsigned bits) noexcept {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+///SHA-1 is only needed to compute handshake, so it is done in the simplest way.
+static std::array<unsigned char, 20> sha1(std::string_view data) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string message(data);
+    message.push_back(static_cast<char>(0x80));
+    while (message.size() % 64 != 56) message.push_back('\0');
+    const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        message.push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+
+    for (size_t chunk = 0; chunk < message.size(); chunk += 64) {
+        uint32_t words[80];
+        for (size_t idx = 0; idx < 16; idx++) {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(message.data() + chunk + idx * 4);
+            words[idx] = static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 | static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+        }
+        for (size_t idx = 16; idx < 80; idx++) {
+            words[idx] = rotate(words[idx - 3] ^ words[idx - 8] ^ words[idx - 14] ^ words[idx - 16], 1);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (size_t idx = 0; idx < 80; idx++) {
+            uint32_t f, k;
+            if (idx < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (idx < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (idx < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            const uint32_t temp = rotate(a, 5) + f + e + k + words[idx];
+            e = d;
+            d = c;
+            c = rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+    std::array<unsigned char, 20> result;
+    for (size_t idx = 0; idx < 20; idx++) {
+        result[idx] = static_cast<unsigned char>((state[idx / 4] >> (24 - (idx % 4) * 8)) & 0xFF);
+    }
+    return result;
+}
+
+static std::string base64(const unsigned char* data, size_t size) {
+    static constexpr std::string_view ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string result;
+    for (size_t idx = 0; idx < size; idx += 3) {
+        const size_t left = std::min<size_t>(size - idx, 3);
+        uint32_t group = static_cast<uint32_t>(data[idx]) << 16;
+        if (left > 1) group |= static_cast<uint32_t>(data[idx + 1]) << 8;
+        if (left > 2) group |= data[idx + 2];
+
+        result.push_back(ALPHABET[(group >> 18) & 0x3F]);
+        result.push_back(ALPHABET[(group >> 12) & 0x3F]);
+        result.push_back(left > 1 ? ALPHABET[(group >> 6) & 0x3F] : '=');
+        result.push_back(left > 2 ? ALPHABET[group & 0x3F] : '=');
+    }
+    return result;
+}
+
+std::string_view websocket::key(std::string_view request) noexcept {
+    static constexpr std::string_view HEADER = "sec-websocket-key:";
+
+    for (size_t start = 0; start < request.size();) {
+        size_t end = request.find("\r\n", start);
+        if (end == std::string_view::npos) end = request.size();
+        auto line = request.substr(start, end - start);
+        start = end + 2;
+
+        if (line.size() < HEADER.size()) continue;
+        const bool is_key = std::equal(HEADER.begin(), HEADER.end(), line.begin(), [](char expected, char actual) {
+            return expected == std::tolower(static_cast<unsigned char>(actual));
+        });
+        if (!is_key) continue;
+
+        line.remove_prefix(HEADER.size());
+        while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+        while (!line.empty() && (line.back() == ' ' || line.back() == '\t')) line.remove_suffix(1);
+        return line;
+    }
+
+    return std::string_view();
+}
+
+std::string websocket::accept(std::string_view key) {
+    std::string proof(key);
+    proof.append(GUID);
+    const auto digest = sha1(proof);
+
+    std::string result = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    result.append(base64(digest.data(), digest.size()));
+    result.append("\r\n\r\n");
+    return result;
+}
+
+size_t websocket::text_header(size_t payload_size, char* header) noexcept {
+    //FIN and text opcode.
+    header[0] = static_cast<char>(0x81);
+
+    if (payload_size < 126) {
+        header[1] = static_cast<char>(payload_size);
+        return 2;
+    }
+    else if (payload_size <= 0xFFFF) {
+        header[1] = 126;
+        header[2] = static_cast<char>((payload_size >> 8) & 0xFF);
+        header[3] = static_cast<char>(payload_size & 0xFF);
+        return 4;
+    }
+
+    header[1] = 127;
+    for (size_t idx = 0; idx < 8; idx++) {
+        header[2 + idx] = static_cast<char>((static_cast<uint64_t>(payload_size) >> ((7 - idx) * 8)) & 0xFF);
+    }
+    return MAX_HEADER;
+}
+
+websocket::Frame websocket::parse(std::string_view buffer, size_t& size) noexcept {
+    if (buffer.size() < 2) return Frame::Incomplete;
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+    const unsigned opcode = bytes[0] & 0x0F;
+    const bool is_masked = (bytes[1] & 0x80) != 0;
+
+    uint64_t payload = bytes[1] & 0x7F;
+    size_t header = 2;
+    if (payload == 126) {
+        header = 4;
+        if (buffer.size() < header) return Frame::Incomplete;
+        payload = static_cast<uint64_t>(bytes[2]) << 8 | bytes[3];
+    }
+    else if (payload == 127) {
+        header = 10;
+        if (buffer.size() < header) return Frame::Incomplete;
+        payload = 0;
+        for (size_t idx = 2; idx < 10; idx++) {
+            payload = payload << 8 | bytes[idx];
+        }
+    }
+    if (is_masked) header += 4;
+
+    if (buffer.size() < header || buffer.size() - header < payload) return Frame::Incomplete;
+    size = header + static_cast<size_t>(payload);
+    return opcode == 0x8 ? Frame::Close : Frame::Data;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace service {
+    ///Minimal server side of WebSocket (RFC 6455), enough to push text to browser.
+    namespace websocket {
+        ///Maximum size of frame header without mask.
+        static constexpr size_t MAX_HEADER = 10;
+
+        ///Reads `Sec-WebSocket-Key` of upgrade request.
+        ///
+        ///@param request HTTP request up to empty line.
+        ///@return Key, empty if request is not WebSocket upgrade.
+        std::string_view key(std::string_view request) noexcept;
+        ///@return Response to upgrade request with key.
+        std::string accept(std::string_view key);
+
+        ///Writes header of unmasked final text frame.
+        ///
+        ///@return Size of header.
+        size_t text_header(size_t payload_size, char* header) noexcept;
+
+        enum class Frame {
+            Incomplete,
+            Data,
+            Close,
+        };
+
+        ///Parses frame from client at start of buffer.
+        ///
+        ///@param size Receives size of whole frame, if it is complete.
+        Frame parse(std::string_view buffer, size_t& size) noexcept;
+    }
+}
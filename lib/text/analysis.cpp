@@ -0,0 +1,665 @@
+#include <algorithm>
+#include <limits>
+#include <deque>
+
+#include "analysis.hpp"
+
+using namespace text;
+
+typedef std::vector<std::pair<wchar_t, wchar_t>> Label;
+typedef std::vector<std::vector<size_t>> Graph;
+
+static constexpr size_t npos = static_cast<size_t>(-1);
+static constexpr wchar_t MIN_CHAR = std::numeric_limits<wchar_t>::min();
+static constexpr wchar_t MAX_CHAR = std::numeric_limits<wchar_t>::max();
+///Maximum number of automaton states to analyze.
+static constexpr size_t MAX_STATES = 160;
+///Maximum number of states to look for polynomial ambiguity, as it needs cube of states.
+static constexpr size_t MAX_POLY_STATES = 48;
+///Counted repetitions are unrolled up to this number, which is enough to find ambiguity.
+static constexpr unsigned MAX_UNROLL = 2;
+///Maximum length of pump, which is as long as the longest generated text.
+static constexpr size_t MAX_PUMP = 64 * 1024;
+
+///Labels are kept sorted and merged.
+static Label complement(const Label& label) {
+    Label result;
+    wchar_t next = MIN_CHAR;
+    for (const auto& range : label) {
+        if (range.first > next) result.emplace_back(next, range.first - 1);
+        if (range.second == MAX_CHAR) return result;
+        next = range.second + 1;
+    }
+    result.emplace_back(next, MAX_CHAR);
+    return result;
+}
+
+static Label intersect(const Label& left, const Label& right) {
+    Label result;
+    size_t left_idx = 0;
+    size_t right_idx = 0;
+
+    while (left_idx < left.size() && right_idx < right.size()) {
+        const wchar_t low = std::max(left[left_idx].first, right[right_idx].first);
+        const wchar_t high = std::min(left[left_idx].second, right[right_idx].second);
+        if (low <= high) result.emplace_back(low, high);
+
+        if (left[left_idx].second < right[right_idx].second) {
+            left_idx += 1;
+        }
+        else {
+            right_idx += 1;
+        }
+    }
+
+    return result;
+}
+
+static Label unite(const Label& left, const Label& right) {
+    return complement(intersect(complement(left), complement(right)));
+}
+
+static Label everything() {
+    return Label{{MIN_CHAR, MAX_CHAR}};
+}
+
+static Label any_char() {
+    return complement(Label{{L'\n', L'\n'}, {L'\r', L'\r'}, {0x2028, 0x2029}});
+}
+
+///Picks up to `count` distinct characters, preferring readable ones.
+static std::wstring sample(const Label& label, size_t count) {
+    static const Label PREFERRED{{L'a', L'z'}, {0x3041, 0x3096}, {0x4E00, 0x9FFF}};
+
+    const auto is_preferred = [](long long ch) {
+        for (const auto& range : PREFERRED) {
+            if (ch >= range.first && ch <= range.second) return true;
+        }
+        return false;
+    };
+
+    std::wstring result;
+    for (const auto& range : intersect(label, PREFERRED)) {
+        for (long long ch = range.first; ch <= range.second && result.size() < count; ch++) {
+            result.push_back(static_cast<wchar_t>(ch));
+        }
+    }
+    for (const auto& range : label) {
+        //Control characters are skipped, except of line end.
+        if (range.first <= L'\n' && range.second >= L'\n' && result.size() < count) result.push_back(L'\n');
+
+        for (long long ch = std::max<long long>(range.first, 0x20); ch <= range.second && result.size() < count; ch++) {
+            if (!is_preferred(ch)) result.push_back(static_cast<wchar_t>(ch));
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Glushkov automaton: each state corresponds to character consuming part of pattern.
+ *
+ * State 0 is initial. Transition into state consumes character from its label.
+ */
+struct Automaton {
+    std::vector<Label> labels;
+    Graph follow;
+    ///Whether match can end in state, unless it is prevented by assertion.
+    std::vector<bool> accepting;
+    ///States of back references.
+    std::vector<bool> backref;
+    bool overflow = false;
+
+    size_t add(Label&& label, bool is_backref) {
+        if (this->labels.size() >= MAX_STATES) {
+            this->overflow = true;
+            return 0;
+        }
+        this->labels.push_back(std::move(label));
+        this->follow.emplace_back();
+        this->accepting.push_back(false);
+        this->backref.push_back(is_backref);
+        return this->labels.size() - 1;
+    }
+
+    void link(const std::vector<size_t>& from, const std::vector<size_t>& to) {
+        for (const auto state : from) {
+            for (const auto next : to) {
+                auto& targets = this->follow[state];
+                if (std::find(targets.begin(), targets.end(), next) == targets.end()) targets.push_back(next);
+            }
+        }
+    }
+};
+
+class Builder {
+    public:
+        ///Summary of node.
+        struct Info {
+            ///Whether node can match empty string.
+            bool nullable = true;
+            ///Whether node can match empty string without assertions.
+            bool transparent = true;
+            std::vector<size_t> first;
+            std::vector<size_t> last;
+            ///States after which rest of node may be skipped without assertions.
+            std::vector<size_t> tail;
+        };
+
+    private:
+        Automaton& automaton;
+
+        static void merge(std::vector<size_t>& to, const std::vector<size_t>& from) {
+            for (const auto state : from) {
+                if (std::find(to.begin(), to.end(), state) == to.end()) to.push_back(state);
+            }
+        }
+
+        Info concat(Info&& left, Info&& right) {
+            this->automaton.link(left.last, right.first);
+
+            Info result;
+            result.first = std::move(left.first);
+            if (left.nullable) merge(result.first, right.first);
+            result.last = right.last;
+            if (right.nullable) merge(result.last, left.last);
+            result.tail = std::move(right.tail);
+            if (right.transparent) merge(result.tail, left.tail);
+            result.nullable = left.nullable && right.nullable;
+            result.transparent = left.transparent && right.transparent;
+            return result;
+        }
+
+        Info star(Info&& body) {
+            this->automaton.link(body.last, body.first);
+            body.nullable = true;
+            body.transparent = true;
+            return body;
+        }
+
+        Info leaf(Label&& label, bool is_backref = false) {
+            const size_t state = this->automaton.add(std::move(label), is_backref);
+
+            Info result;
+            result.first.push_back(state);
+            result.last.push_back(state);
+            result.tail.push_back(state);
+            //Back reference may match empty string, but usually it is there to fail otherwise.
+            result.nullable = is_backref;
+            result.transparent = false;
+            if (is_backref) this->automaton.link(result.last, result.first);
+            return result;
+        }
+
+        Info repeat(const Node& node) {
+            const Node& child = node.children.front();
+
+            Info result;
+            const unsigned required = std::min(node.min, MAX_UNROLL);
+            for (unsigned idx = 0; idx < required; idx++) {
+                result = this->concat(std::move(result), this->build(child));
+            }
+
+            if (node.max == Node::UNBOUNDED) {
+                return this->concat(std::move(result), this->star(this->build(child)));
+            }
+
+            const unsigned optional = std::min(node.max - node.min, MAX_UNROLL);
+            for (unsigned idx = 0; idx < optional; idx++) {
+                Info copy = this->build(child);
+                copy.nullable = true;
+                copy.transparent = true;
+                result = this->concat(std::move(result), std::move(copy));
+            }
+
+            return result;
+        }
+
+    public:
+        explicit Builder(Automaton& automaton) noexcept : automaton(automaton) {}
+
+        Info build(const Node& node) {
+            switch (node.kind) {
+                case Node::Kind::Char:
+                    return this->leaf(Label{{node.ch, node.ch}});
+                case Node::Kind::Any:
+                    return this->leaf(any_char());
+                case Node::Kind::Class:
+                    return this->leaf(node.cls.negated ? complement(node.cls.ranges) : Label(node.cls.ranges));
+                case Node::Kind::Backref:
+                    return this->leaf(everything(), true);
+                case Node::Kind::Group:
+                    return this->build(node.children.front());
+                case Node::Kind::Concat: {
+                    Info result;
+                    for (const auto& child : node.children) {
+                        result = this->concat(std::move(result), this->build(child));
+                    }
+                    return result;
+                }
+                case Node::Kind::Alternate: {
+                    Info result;
+                    result.nullable = false;
+                    result.transparent = false;
+                    for (const auto& child : node.children) {
+                        Info info = this->build(child);
+                        merge(result.first, info.first);
+                        merge(result.last, info.last);
+                        merge(result.tail, info.tail);
+                        result.nullable = result.nullable || info.nullable;
+                        result.transparent = result.transparent || info.transparent;
+                    }
+                    return result;
+                }
+                case Node::Kind::Repeat:
+                    return this->repeat(node);
+                case Node::Kind::Empty: {
+                    return Info();
+                }
+                default: {
+                    //Assertions consume nothing, but may prevent match.
+                    Info result;
+                    result.transparent = false;
+                    return result;
+                }
+            }
+        }
+};
+
+///Strongly connected components by Kosaraju algorithm.
+///
+///Components are numbered in topological order.
+static std::vector<size_t> components(const Graph& graph, size_t& count) {
+    const size_t size = graph.size();
+    Graph reversed(size);
+    for (size_t node = 0; node < size; node++) {
+        for (const auto next : graph[node]) {
+            reversed[next].push_back(node);
+        }
+    }
+
+    std::vector<size_t> order;
+    std::vector<bool> visited(size, false);
+    std::vector<std::pair<size_t, size_t>> stack;
+    for (size_t root = 0; root < size; root++) {
+        if (visited[root]) continue;
+        visited[root] = true;
+        stack.emplace_back(root, 0);
+
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.second < graph[top.first].size()) {
+                const size_t next = graph[top.first][top.second++];
+                if (!visited[next]) {
+                    visited[next] = true;
+                    stack.emplace_back(next, 0);
+                }
+            }
+            else {
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+        }
+    }
+
+    std::vector<size_t> result(size, npos);
+    count = 0;
+    for (auto iter = order.rbegin(); iter != order.rend(); ++iter) {
+        if (result[*iter] != npos) continue;
+
+        std::vector<size_t> pending{*iter};
+        result[*iter] = count;
+        while (!pending.empty()) {
+            const size_t node = pending.back();
+            pending.pop_back();
+            for (const auto prev : reversed[node]) {
+                if (result[prev] == npos) {
+                    result[prev] = count;
+                    pending.push_back(prev);
+                }
+            }
+        }
+        count += 1;
+    }
+
+    return result;
+}
+
+class Analyzer {
+    private:
+        const Automaton& automaton;
+        size_t size;
+
+        bool overlaps(size_t left, size_t right) const {
+            return !intersect(this->automaton.labels[left], this->automaton.labels[right]).empty();
+        }
+
+    public:
+        explicit Analyzer(const Automaton& automaton) noexcept : automaton(automaton), size(automaton.labels.size()) {}
+
+        ///@return Shortest text leading from initial state to `target`.
+        std::wstring path_to(size_t target) const {
+            std::vector<size_t> parent(this->size, npos);
+            std::deque<size_t> queue{0};
+            parent[0] = 0;
+
+            while (!queue.empty()) {
+                const size_t state = queue.front();
+                queue.pop_front();
+                if (state == target) break;
+
+                for (const auto next : this->automaton.follow[state]) {
+                    if (parent[next] != npos) continue;
+                    parent[next] = state;
+                    queue.push_back(next);
+                }
+            }
+
+            std::wstring result;
+            for (size_t state = target; state != 0 && parent[state] != npos; state = parent[state]) {
+                const auto ch = sample(this->automaton.labels[state], 1);
+                result.push_back(ch.empty() ? L'?' : ch.front());
+            }
+            std::reverse(result.begin(), result.end());
+            return result;
+        }
+
+        /**
+         * Looks for state with two distinct loops on the same text.
+         *
+         * Such state is in component of pairs automaton with both equal and distinct states.
+         *
+         * @return Pair of distinct states within such loop or npos.
+         */
+        std::pair<size_t, size_t> exponential() const {
+            const size_t pairs = this->size * this->size;
+            Graph graph(pairs);
+            std::vector<bool> visited(pairs, false);
+            std::vector<size_t> pending{0};
+            visited[0] = true;
+
+            while (!pending.empty()) {
+                const size_t pair = pending.back();
+                pending.pop_back();
+                const size_t left = pair / this->size;
+                const size_t right = pair % this->size;
+
+                for (const auto left_next : this->automaton.follow[left]) {
+                    for (const auto right_next : this->automaton.follow[right]) {
+                        if (!this->overlaps(left_next, right_next)) continue;
+
+                        const size_t next = left_next * this->size + right_next;
+                        graph[pair].push_back(next);
+                        if (!visited[next]) {
+                            visited[next] = true;
+                            pending.push_back(next);
+                        }
+                    }
+                }
+            }
+
+            size_t count = 0;
+            const auto component = components(graph, count);
+            std::vector<size_t> diagonal(count, npos);
+            for (size_t state = 0; state < this->size; state++) {
+                const size_t pair = state * this->size + state;
+                //Once we're in accepting state, match succeeds without backtracking.
+                if (visited[pair] && !this->automaton.accepting[state]) diagonal[component[pair]] = state;
+            }
+
+            for (size_t pair = 0; pair < pairs; pair++) {
+                const size_t left = pair / this->size;
+                const size_t right = pair % this->size;
+                if (!visited[pair] || left == right) continue;
+                if (diagonal[component[pair]] != npos) return std::make_pair(left, right);
+            }
+
+            return std::make_pair(npos, npos);
+        }
+
+        /**
+         * Checks whether there is text which loops on `from`, loops on `to` and leads from `from` to `to`.
+         *
+         * Such pair of loops makes matcher to try every split of text between them.
+         *
+         * @param[out] witness Shortest such text.
+         */
+        bool polynomial(size_t from, size_t to, const std::vector<size_t>& component, std::wstring& witness) const {
+            const size_t size = this->size;
+            const auto index = [size](size_t first, size_t second, size_t third) {
+                return (first * size + second) * size + third;
+            };
+
+            //Previous triple and character leading from it.
+            std::vector<std::pair<size_t, wchar_t>> parent(size * size * size, std::make_pair(npos, L'\0'));
+            std::deque<size_t> queue{index(from, from, to)};
+            parent[queue.front()].first = queue.front();
+            const size_t target = index(from, to, to);
+
+            while (!queue.empty()) {
+                const size_t triple = queue.front();
+                queue.pop_front();
+                const size_t first = triple / (size * size);
+                const size_t second = triple / size % size;
+                const size_t third = triple % size;
+
+                for (const auto first_next : this->automaton.follow[first]) {
+                    if (component[first_next] != component[from]) continue;
+                    for (const auto second_next : this->automaton.follow[second]) {
+                        if (!this->overlaps(first_next, second_next)) continue;
+                        for (const auto third_next : this->automaton.follow[third]) {
+                            if (component[third_next] != component[to]) continue;
+
+                            const auto common = intersect(intersect(this->automaton.labels[first_next], this->automaton.labels[second_next]), this->automaton.labels[third_next]);
+                            if (common.empty()) continue;
+
+                            const size_t next = index(first_next, second_next, third_next);
+                            if (parent[next].first != npos) continue;
+                            const auto ch = sample(common, 1);
+                            parent[next] = std::make_pair(triple, ch.empty() ? common.front().first : ch.front());
+
+                            if (next == target) {
+                                witness.clear();
+                                for (size_t step = target; step != parent[step].first; step = parent[step].first) {
+                                    witness.push_back(parent[step].second);
+                                }
+                                std::reverse(witness.begin(), witness.end());
+                                return true;
+                            }
+                            queue.push_back(next);
+                        }
+                    }
+                }
+            }
+
+            return false;
+        }
+};
+
+static bool has_backref_after_loop(const Node& node, bool& loop_seen) {
+    switch (node.kind) {
+        case Node::Kind::Backref:
+            return loop_seen;
+        case Node::Kind::Repeat:
+            if (node.max == Node::UNBOUNDED) loop_seen = true;
+            break;
+        default:
+            break;
+    }
+
+    for (const auto& child : node.children) {
+        if (has_backref_after_loop(child, loop_seen)) return true;
+    }
+
+    return false;
+}
+
+Analysis text::analyze(const Regex& regex) {
+    Analysis result;
+
+    Automaton automaton;
+    automaton.add(everything(), false);
+    Builder builder(automaton);
+    const auto info = builder.build(regex.ast());
+
+    if (automaton.overflow) {
+        result.complexity = Analysis::Complexity::Unknown;
+        result.reason = "pattern is too big to analyze";
+        return result;
+    }
+
+    automaton.link({0}, info.first);
+    //Matcher retries pattern from every position, unless it knows it is pointless.
+    if (!regex.is_anchored() && !regex.is_line_anchored()) automaton.link({0}, {0});
+    for (const auto state : info.tail) {
+        automaton.accepting[state] = true;
+    }
+    automaton.accepting[0] = info.transparent;
+
+    const Analyzer analyzer(automaton);
+    const size_t size = automaton.labels.size();
+
+    Label all;
+    for (size_t state = 1; state < automaton.labels.size(); state++) {
+        all = unite(all, automaton.labels[state]);
+    }
+    //Text of pattern's characters only, which then fails on character pattern doesn't expect.
+    result.suffixes = sample(complement(all), 1) + L"\n";
+
+    const auto ambiguous = analyzer.exponential();
+    if (ambiguous.first != npos) {
+        result.complexity = Analysis::Complexity::Exponential;
+        result.reason = "nested quantifiers or overlapping alternatives can match the same text in exponentially many ways";
+        result.prefix = analyzer.path_to(ambiguous.first);
+        result.pump = sample(intersect(automaton.labels[ambiguous.first], automaton.labels[ambiguous.second]), 16);
+        return result;
+    }
+
+    if (size > MAX_POLY_STATES) {
+        result.complexity = Analysis::Complexity::Unknown;
+        result.reason = "pattern is too big to look for polynomial backtracking";
+        return result;
+    }
+
+    size_t count = 0;
+    const auto component = components(automaton.follow, count);
+
+    std::vector<bool> cyclic(count, false);
+    for (size_t state = 0; state < size; state++) {
+        for (const auto next : automaton.follow[state]) {
+            if (component[next] == component[state]) cyclic[component[state]] = true;
+        }
+    }
+
+    //Longest chain of loops, that can consume the same text one after another.
+    std::vector<unsigned> degree(count, 0);
+    std::vector<size_t> head(count, npos);
+    //Text which makes the last pair of loops in chain ambiguous.
+    std::vector<std::wstring> witness(count);
+    size_t deepest = npos;
+    for (size_t to = 0; to < size; to++) {
+        if (!cyclic[component[to]] || automaton.accepting[to]) continue;
+        degree[component[to]] = std::max(degree[component[to]], 1u);
+        if (head[component[to]] == npos) head[component[to]] = to;
+    }
+
+    //Components are in topological order, so predecessors are finished before.
+    for (size_t target = 0; target < count; target++) {
+        for (size_t to = 0; to < size; to++) {
+            if (component[to] != target || !cyclic[target] || automaton.accepting[to]) continue;
+
+            for (size_t from = 0; from < size; from++) {
+                const size_t source = component[from];
+                if (source >= target || !cyclic[source] || automaton.accepting[from]) continue;
+                if (degree[source] + 1 <= degree[target]) continue;
+
+                std::wstring word;
+                if (analyzer.polynomial(from, to, component, word)) {
+                    degree[target] = degree[source] + 1;
+                    head[target] = head[source];
+                    witness[target] = std::move(word);
+                }
+            }
+        }
+
+        if (degree[target] > 0 && (deepest == npos || degree[target] > degree[deepest])) deepest = target;
+    }
+
+    result.degree = deepest == npos ? 1 : degree[deepest];
+
+    bool loop_seen = false;
+    const bool backref = has_backref_after_loop(regex.ast(), loop_seen);
+    //Each back reference compares text, that has been captured by loop.
+    if (backref && result.degree > 1) result.degree += 1;
+
+    if (deepest != npos) {
+        size_t loop = npos;
+        for (size_t state = 0; state < size && loop == npos; state++) {
+            if (component[state] == deepest && !automaton.accepting[state]) loop = state;
+        }
+        result.prefix = analyzer.path_to(head[deepest]);
+        result.pump = witness[deepest];
+        //Back reference is defeated by text without repetitions.
+        if (result.pump.empty() || backref) result.pump = sample(automaton.labels[loop], MAX_PUMP);
+    }
+
+    if (result.degree > 1) {
+        result.complexity = Analysis::Complexity::Polynomial;
+        result.reason = std::to_string(result.degree) + " quantifiers can match the same text one after another";
+        if (backref) result.reason += ", back reference compares text captured by quantifier";
+    }
+    else {
+        result.complexity = Analysis::Complexity::Linear;
+        result.reason = "no ambiguous quantifiers";
+    }
+
+    return result;
+}
+
+const char* text::to_string(Analysis::Complexity complexity) noexcept {
+    switch (complexity) {
+        case Analysis::Complexity::Linear: return "linear";
+        case Analysis::Complexity::Polynomial: return "polynomial";
+        case Analysis::Complexity::Exponential: return "exponential";
+        default: return "unknown";
+    }
+}
+
+std::vector<Sample> text::measure(const Replacer& replacer, const Analysis& analysis, std::chrono::microseconds limit) {
+    static constexpr size_t MIN_LENGTH = 16;
+    static constexpr size_t MAX_LENGTH = MAX_PUMP;
+
+    std::vector<Sample> result;
+    if (analysis.pump.empty()) return result;
+
+    for (size_t length = MIN_LENGTH; length <= MAX_LENGTH; length *= 2) {
+        Sample sample{length, std::chrono::microseconds(0), false};
+
+        //Both single repeated character and distinct characters, which defeat back references.
+        std::vector<std::wstring> pumps{analysis.pump.substr(0, 1)};
+        if (analysis.pump.size() > 1) pumps.push_back(analysis.pump);
+
+        for (const auto& pump : pumps) {
+            for (const auto suffix : analysis.suffixes) {
+                std::wstring text(analysis.prefix);
+                while (text.size() < analysis.prefix.size() + length) {
+                    text.push_back(pump[text.size() % pump.size()]);
+                }
+                text.push_back(suffix);
+
+                Regex::Limits limits(Budget{0, limit});
+                const auto start = std::chrono::steady_clock::now();
+                const auto status = replacer.apply(text, limits);
+                const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+                sample.time = std::max(sample.time, elapsed);
+                sample.exhausted = sample.exhausted || status == Regex::Status::Exhausted;
+            }
+        }
+
+        result.push_back(sample);
+        if (sample.exhausted) break;
+    }
+
+    return result;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "regex.hpp"
+#include "text.hpp"
+
+namespace text {
+    /**
+     * Backtracking complexity of pattern.
+     *
+     * Pattern is turned into automaton which is checked for ambiguity:
+     *
+     * - Exponential: there is state, which can loop onto itself by two different paths on the same text.
+     *   Typically nested quantifiers, like `(a+)+`, or overlapping alternations, like `(a|a)*`.
+     * - Polynomial: there are several loops, which can consume the same text one after another, like `.*.*`.
+     *   Degree is number of such loops. Back reference is considered as loop over any text.
+     * - Linear: otherwise.
+     *
+     * Unanchored pattern is retried from every position, which is considered as loop too.
+     */
+    struct Analysis {
+        enum class Complexity {
+            Linear,
+            Polynomial,
+            Exponential,
+            ///Pattern is too big to analyze.
+            Unknown,
+        };
+
+        Complexity complexity = Complexity::Unknown;
+        ///Degree of polynomial.
+        unsigned degree = 0;
+        ///Human readable explanation.
+        std::string reason;
+
+        ///Text which leads to ambiguous part of pattern.
+        std::wstring prefix;
+        ///Characters to repeat in order to make matcher to backtrack.
+        std::wstring pump;
+        ///Characters which may make match to fail after pumped text.
+        std::wstring suffixes;
+    };
+
+    ///Analyzes pattern.
+    Analysis analyze(const Regex& regex);
+
+    ///@return Name of complexity class.
+    const char* to_string(Analysis::Complexity complexity) noexcept;
+
+    /**
+     * Time of rule on adversarial text.
+     */
+    struct Sample {
+        ///Length of text.
+        size_t length;
+        ///Worst time among generated texts.
+        std::chrono::microseconds time;
+        ///Whether rule did not finish within limit.
+        bool exhausted;
+    };
+
+    /**
+     * Measures rule on adversarial texts of growing length, generated from analysis.
+     *
+     * Stops once rule takes longer than `limit`.
+     */
+    std::vector<Sample> measure(const Replacer& replacer, const Analysis& analysis, std::chrono::microseconds limit);
+}
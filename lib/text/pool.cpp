@@ -0,0 +1,163 @@
+#include <algorithm>
+
+#include "pool.hpp"
+
+using namespace text;
+
+///Range holds 32 bit bounds, so bigger runs are split into slices.
+static constexpr size_t MAX_SLICE = 0xFFFFFFFF;
+
+static inline uint64_t pack(uint64_t begin, uint64_t end) noexcept {
+    return begin << 32 | end;
+}
+
+static inline uint64_t range_begin(uint64_t bounds) noexcept {
+    return bounds >> 32;
+}
+
+static inline uint64_t range_end(uint64_t bounds) noexcept {
+    return bounds & 0xFFFFFFFF;
+}
+
+Pool::Pool(unsigned threads) :
+    workers(threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : threads),
+    task(nullptr),
+    generation(0),
+    pending(0),
+    stopping(false)
+{
+    this->ranges.reset(new Range[this->workers]);
+
+    this->threads.reserve(this->workers - 1);
+    for (unsigned worker = 1; worker < this->workers; worker++) {
+        this->threads.emplace_back(&Pool::serve, this, worker);
+    }
+}
+
+Pool::~Pool() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+
+    for (auto& thread : this->threads) {
+        thread.join();
+    }
+}
+
+unsigned Pool::size() const noexcept {
+    return this->workers;
+}
+
+bool Pool::pop(unsigned worker, size_t& index) noexcept {
+    auto& bounds = this->ranges[worker].bounds;
+    uint64_t current = bounds.load(std::memory_order_acquire);
+
+    for (;;) {
+        const uint64_t begin = range_begin(current);
+        const uint64_t end = range_end(current);
+        if (begin >= end) return false;
+
+        if (bounds.compare_exchange_weak(current, pack(begin + 1, end), std::memory_order_acq_rel)) {
+            index = static_cast<size_t>(begin);
+            return true;
+        }
+    }
+}
+
+bool Pool::steal(unsigned worker) noexcept {
+    for (unsigned offset = 1; offset < this->workers; offset++) {
+        auto& bounds = this->ranges[(worker + offset) % this->workers].bounds;
+        uint64_t current = bounds.load(std::memory_order_acquire);
+
+        for (;;) {
+            const uint64_t begin = range_begin(current);
+            const uint64_t end = range_end(current);
+            if (begin >= end) break;
+
+            //Victim keeps lower half, which it is going to take next anyway.
+            const uint64_t middle = begin + (end - begin) / 2;
+            if (bounds.compare_exchange_weak(current, pack(begin, middle), std::memory_order_acq_rel)) {
+                //Own range is empty, so nobody else changes it.
+                this->ranges[worker].bounds.store(pack(middle, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void Pool::work(unsigned worker) {
+    size_t index = 0;
+
+    do {
+        while (this->pop(worker, index)) {
+            try {
+                (*this->task)(worker, index);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> guard(this->lock);
+                if (!this->error) this->error = std::current_exception();
+            }
+        }
+    } while (this->steal(worker));
+}
+
+void Pool::serve(unsigned worker) {
+    uint64_t seen = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->wake.wait(guard, [this, seen]() { return this->stopping || this->generation != seen; });
+            if (this->stopping) return;
+            seen = this->generation;
+        }
+
+        this->work(worker);
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->pending -= 1;
+        }
+        this->done.notify_one();
+    }
+}
+
+void Pool::run(size_t count, const Task& task) {
+    for (size_t offset = 0; offset < count; offset += MAX_SLICE) {
+        const size_t slice = std::min(count - offset, MAX_SLICE);
+        const Task sliced = [&task, offset](unsigned worker, size_t index) {
+            task(worker, offset + index);
+        };
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            for (unsigned worker = 0; worker < this->workers; worker++) {
+                const uint64_t begin = slice * worker / this->workers;
+                const uint64_t end = slice * (worker + 1) / this->workers;
+                this->ranges[worker].bounds.store(pack(begin, end), std::memory_order_relaxed);
+            }
+
+            this->task = offset == 0 && slice == count ? &task : &sliced;
+            this->pending = this->workers - 1;
+            this->generation += 1;
+        }
+        this->wake.notify_all();
+
+        this->work(0);
+
+        std::unique_lock<std::mutex> guard(this->lock);
+        this->done.wait(guard, [this]() { return this->pending == 0; });
+        this->task = nullptr;
+
+        if (this->error) {
+            std::exception_ptr error;
+            std::swap(error, this->error);
+            guard.unlock();
+            std::rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace text {
+    /**
+     * Pool of threads, that runs loop over indexes in parallel.
+     *
+     * Indexes are split evenly between workers. Worker, that runs out of its own indexes,
+     * steals half of the remaining ones from another worker, so uneven items do not leave
+     * workers idle.
+     *
+     * Calling thread takes part in work as worker 0.
+     */
+    class Pool {
+        public:
+            ///Called with worker number and index.
+            typedef std::function<void(unsigned, size_t)> Task;
+
+        private:
+            ///Remaining indexes of worker, packed as `begin << 32 | end`, so that they are taken by single CAS.
+            struct alignas(64) Range {
+                std::atomic<uint64_t> bounds{0};
+            };
+
+            std::vector<std::thread> threads;
+            std::unique_ptr<Range[]> ranges;
+            unsigned workers;
+
+            std::mutex lock;
+            std::condition_variable wake;
+            std::condition_variable done;
+            const Task* task;
+            ///Number of run, so that workers know there is new one.
+            uint64_t generation;
+            ///Number of threads still working on current run.
+            unsigned pending;
+            bool stopping;
+            std::exception_ptr error;
+
+            void work(unsigned worker);
+            void serve(unsigned worker);
+            bool pop(unsigned worker, size_t& index) noexcept;
+            bool steal(unsigned worker) noexcept;
+
+        public:
+            ///Starts pool of `threads` workers, 0 means number of cores.
+            explicit Pool(unsigned threads = 0);
+            ~Pool();
+
+            Pool(const Pool&) = delete;
+            Pool& operator=(const Pool&) = delete;
+
+            ///@return Number of workers, including calling thread.
+            unsigned size() const noexcept;
+
+            /**
+             * Runs task for every index in `[0, count)` and waits for completion.
+             *
+             * Only one run at a time is allowed.
+             *
+             * @throws Exception thrown by task, remaining indexes are still processed.
+             */
+            void run(size_t count, const Task& task);
+    };
+}
@@ -0,0 +1,1150 @@
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <cwchar>
+
+#include "regex.hpp"
+
+using namespace text;
+
+static constexpr size_t npos = static_cast<size_t>(-1);
+///Maximum number of instructions in compiled program.
+static constexpr size_t MAX_PROGRAM_SIZE = 1 << 20;
+///Maximum value of counted repetition.
+static constexpr unsigned MAX_REPEAT = 1000;
+///Deadline and cancellation are checked once per this number of steps as clock is not that cheap.
+static constexpr uint64_t DEADLINE_CHECK_MASK = 1023;
+
+static constexpr wchar_t MAX_CHAR = std::numeric_limits<wchar_t>::max();
+
+[[noreturn]] static void fail(const char* reason, size_t pos) {
+    throw std::runtime_error(std::string(reason) + " at position " + std::to_string(pos));
+}
+
+static inline bool is_line_terminator(wchar_t ch) noexcept {
+    return ch == L'\n' || ch == L'\r' || ch == 0x2028 || ch == 0x2029;
+}
+
+static inline bool is_word(wchar_t ch) noexcept {
+    return (ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z') || (ch >= L'0' && ch <= L'9') || ch == L'_';
+}
+
+static inline bool is_digit(wchar_t ch) noexcept {
+    return ch >= L'0' && ch <= L'9';
+}
+
+static inline int hex_value(wchar_t ch) noexcept {
+    if (ch >= L'0' && ch <= L'9') return ch - L'0';
+    if (ch >= L'a' && ch <= L'f') return ch - L'a' + 10;
+    if (ch >= L'A' && ch <= L'F') return ch - L'A' + 10;
+    return -1;
+}
+
+typedef std::vector<std::pair<wchar_t, wchar_t>> Ranges;
+
+static void add_digit(Ranges& ranges) {
+    ranges.emplace_back(L'0', L'9');
+}
+
+static void add_word(Ranges& ranges) {
+    ranges.emplace_back(L'0', L'9');
+    ranges.emplace_back(L'A', L'Z');
+    ranges.emplace_back(L'_', L'_');
+    ranges.emplace_back(L'a', L'z');
+}
+
+///White spaces and line terminators as defined by ECMAScript.
+static void add_space(Ranges& ranges) {
+    ranges.emplace_back(0x09, 0x0D);
+    ranges.emplace_back(0x20, 0x20);
+    ranges.emplace_back(0xA0, 0xA0);
+    ranges.emplace_back(0x1680, 0x1680);
+    ranges.emplace_back(0x2000, 0x200A);
+    ranges.emplace_back(0x2028, 0x2029);
+    ranges.emplace_back(0x202F, 0x202F);
+    ranges.emplace_back(0x205F, 0x205F);
+    ranges.emplace_back(0x3000, 0x3000);
+    ranges.emplace_back(0xFEFF, 0xFEFF);
+}
+
+static void normalize(Ranges& ranges) {
+    std::sort(ranges.begin(), ranges.end());
+
+    Ranges result;
+    for (const auto& range : ranges) {
+        if (!result.empty() && (result.back().second == MAX_CHAR || range.first <= result.back().second + 1)) {
+            result.back().second = std::max(result.back().second, range.second);
+        }
+        else {
+            result.push_back(range);
+        }
+    }
+    ranges.swap(result);
+}
+
+static Ranges complement(Ranges ranges) {
+    normalize(ranges);
+
+    Ranges result;
+    wchar_t next = std::numeric_limits<wchar_t>::min();
+    bool done = false;
+    for (const auto& range : ranges) {
+        if (range.first > next) result.emplace_back(next, range.first - 1);
+        if (range.second == MAX_CHAR) {
+            done = true;
+            break;
+        }
+        next = range.second + 1;
+    }
+    if (!done) result.emplace_back(next, MAX_CHAR);
+
+    return result;
+}
+
+///Number of characters in Basic Multilingual Plane.
+static constexpr size_t BMP_SIZE = 0x10000;
+
+void CharClass::prepare() {
+    this->table.assign(BMP_SIZE / 64, 0);
+
+    for (const auto& range : this->ranges) {
+        const long long first = std::max<long long>(range.first, 0);
+        const long long last = std::min<long long>(range.second, BMP_SIZE - 1);
+        for (long long ch = first; ch <= last; ch++) {
+            this->table[static_cast<size_t>(ch) / 64] |= uint64_t(1) << (ch % 64);
+        }
+    }
+}
+
+bool CharClass::matches(wchar_t ch) const noexcept {
+    if (!this->table.empty() && ch >= 0 && static_cast<size_t>(ch) < BMP_SIZE) {
+        const bool found = (this->table[static_cast<size_t>(ch) / 64] >> (ch % 64)) & 1;
+        return found != this->negated;
+    }
+
+    bool found = false;
+    for (const auto& range : this->ranges) {
+        if (ch >= range.first && ch <= range.second) {
+            found = true;
+            break;
+        }
+    }
+
+    return found != this->negated;
+}
+
+///Recursive descent parser of ECMAScript pattern.
+class Parser {
+    private:
+        std::wstring_view src;
+        size_t pos;
+        unsigned max_backref;
+
+        bool at_end() const noexcept {
+            return this->pos >= this->src.size();
+        }
+
+        wchar_t peek() const noexcept {
+            return this->src[this->pos];
+        }
+
+        bool eat(wchar_t ch) noexcept {
+            if (!this->at_end() && this->peek() == ch) {
+                this->pos += 1;
+                return true;
+            }
+            return false;
+        }
+
+        wchar_t next() {
+            if (this->at_end()) fail("Unexpected end of pattern", this->pos);
+            return this->src[this->pos++];
+        }
+
+        static Node make(Node::Kind kind) {
+            Node node;
+            node.kind = kind;
+            return node;
+        }
+
+        unsigned number() {
+            unsigned result = 0;
+            const size_t start = this->pos;
+            while (!this->at_end() && is_digit(this->peek())) {
+                result = result * 10 + static_cast<unsigned>(this->next() - L'0');
+                if (result > MAX_REPEAT) fail("Number is too big", start);
+            }
+            return result;
+        }
+
+        wchar_t hex(size_t len) {
+            unsigned result = 0;
+            for (size_t idx = 0; idx < len; idx++) {
+                const int value = hex_value(this->next());
+                if (value < 0) fail("Invalid hex escape", this->pos - 1);
+                result = result * 16 + static_cast<unsigned>(value);
+            }
+            return static_cast<wchar_t>(result);
+        }
+
+        ///Escapes which denote single character.
+        wchar_t char_escape(wchar_t ch) {
+            switch (ch) {
+                case L't': return L'\t';
+                case L'n': return L'\n';
+                case L'v': return L'\v';
+                case L'f': return L'\f';
+                case L'r': return L'\r';
+                case L'0': return 0;
+                case L'x': return this->hex(2);
+                case L'u': return this->hex(4);
+                case L'c': {
+                    const wchar_t letter = this->next();
+                    if (!((letter >= L'a' && letter <= L'z') || (letter >= L'A' && letter <= L'Z'))) fail("Invalid control escape", this->pos - 1);
+                    return letter % 32;
+                }
+                default: return ch;
+            }
+        }
+
+        ///Escapes which denote set of characters.
+        static bool set_escape(wchar_t ch, Ranges& ranges, bool& negated) {
+            switch (ch) {
+                case L'd': add_digit(ranges); negated = false; return true;
+                case L'D': add_digit(ranges); negated = true; return true;
+                case L'w': add_word(ranges); negated = false; return true;
+                case L'W': add_word(ranges); negated = true; return true;
+                case L's': add_space(ranges); negated = false; return true;
+                case L'S': add_space(ranges); negated = true; return true;
+                default: return false;
+            }
+        }
+
+        Node char_class() {
+            const size_t start = this->pos - 1;
+            Node node = make(Node::Kind::Class);
+            node.cls.negated = this->eat(L'^');
+
+            for (;;) {
+                if (this->at_end()) fail("Unterminated character class", start);
+
+                wchar_t ch = this->next();
+                if (ch == L']') break;
+
+                wchar_t low = ch;
+                if (ch == L'\\') {
+                    const wchar_t escape = this->next();
+                    Ranges set;
+                    bool negated = false;
+                    if (set_escape(escape, set, negated)) {
+                        if (negated) set = complement(std::move(set));
+                        node.cls.ranges.insert(node.cls.ranges.end(), set.begin(), set.end());
+                        continue;
+                    }
+                    low = escape == L'b' ? L'\b' : this->char_escape(escape);
+                }
+
+                if (this->pos + 1 < this->src.size() && this->peek() == L'-' && this->src[this->pos + 1] != L']') {
+                    this->pos += 1;
+                    wchar_t high = this->next();
+                    if (high == L'\\') {
+                        const wchar_t escape = this->next();
+                        Ranges set;
+                        bool negated = false;
+                        if (set_escape(escape, set, negated)) fail("Invalid character class range", this->pos - 1);
+                        high = escape == L'b' ? L'\b' : this->char_escape(escape);
+                    }
+
+                    if (high < low) fail("Character class range is out of order", this->pos - 1);
+                    node.cls.ranges.emplace_back(low, high);
+                }
+                else {
+                    node.cls.ranges.emplace_back(low, low);
+                }
+            }
+
+            normalize(node.cls.ranges);
+            return node;
+        }
+
+        Node escape(bool& quantifiable) {
+            const wchar_t ch = this->next();
+
+            Ranges set;
+            bool negated = false;
+            if (set_escape(ch, set, negated)) {
+                Node node = make(Node::Kind::Class);
+                node.cls.ranges = std::move(set);
+                node.cls.negated = negated;
+                normalize(node.cls.ranges);
+                return node;
+            }
+
+            switch (ch) {
+                case L'b':
+                    quantifiable = false;
+                    return make(Node::Kind::WordBoundary);
+                case L'B':
+                    quantifiable = false;
+                    return make(Node::Kind::NotWordBoundary);
+                default:
+                    break;
+            }
+
+            if (ch >= L'1' && ch <= L'9') {
+                this->pos -= 1;
+                Node node = make(Node::Kind::Backref);
+                node.index = this->number();
+                this->max_backref = std::max(this->max_backref, node.index);
+                return node;
+            }
+
+            Node node = make(Node::Kind::Char);
+            node.ch = this->char_escape(ch);
+            return node;
+        }
+
+        Node group(bool& quantifiable) {
+            const size_t start = this->pos - 1;
+            Node node;
+
+            if (this->eat(L'?')) {
+                if (this->eat(L':')) {
+                    node = this->alternation();
+                }
+                else if (this->eat(L'=') || this->eat(L'!')) {
+                    node = make(this->src[this->pos - 1] == L'=' ? Node::Kind::Lookahead : Node::Kind::NegativeLookahead);
+                    node.children.push_back(this->alternation());
+                    quantifiable = false;
+                }
+                else {
+                    fail("Invalid group", start);
+                }
+            }
+            else {
+                node = make(Node::Kind::Group);
+                node.index = ++this->groups;
+                node.children.push_back(this->alternation());
+            }
+
+            if (!this->eat(L')')) fail("Missing ')'", start);
+            return node;
+        }
+
+        ///Parses `{n}`, `{n,}` or `{n,m}`.
+        bool braces(unsigned& min, unsigned& max) {
+            const size_t start = this->pos;
+
+            if (this->at_end() || !is_digit(this->peek())) {
+                this->pos = start;
+                return false;
+            }
+            min = this->number();
+            max = min;
+
+            if (this->eat(L',')) {
+                if (!this->at_end() && is_digit(this->peek())) {
+                    max = this->number();
+                }
+                else {
+                    max = Node::UNBOUNDED;
+                }
+            }
+
+            if (!this->eat(L'}')) {
+                this->pos = start;
+                return false;
+            }
+
+            return true;
+        }
+
+        Node quantifier(Node&& atom, bool quantifiable) {
+            const size_t start = this->pos;
+            unsigned min = 0;
+            unsigned max = 0;
+
+            if (this->eat(L'*')) {
+                min = 0;
+                max = Node::UNBOUNDED;
+            }
+            else if (this->eat(L'+')) {
+                min = 1;
+                max = Node::UNBOUNDED;
+            }
+            else if (this->eat(L'?')) {
+                min = 0;
+                max = 1;
+            }
+            else if (this->eat(L'{')) {
+                if (!this->braces(min, max)) {
+                    //Annex B: treat as literal.
+                    this->pos -= 1;
+                    return std::move(atom);
+                }
+            }
+            else {
+                return std::move(atom);
+            }
+
+            if (!quantifiable) fail("Nothing to repeat", start);
+            if (max < min) fail("Numbers out of order in quantifier", start);
+
+            Node node = make(Node::Kind::Repeat);
+            node.min = min;
+            node.max = max;
+            node.greedy = !this->eat(L'?');
+            node.children.push_back(std::move(atom));
+            return node;
+        }
+
+        Node term() {
+            const size_t start = this->pos;
+            bool quantifiable = true;
+            Node atom;
+
+            const wchar_t ch = this->next();
+            switch (ch) {
+                case L'^':
+                    atom = make(Node::Kind::Begin);
+                    quantifiable = false;
+                    break;
+                case L'$':
+                    atom = make(Node::Kind::End);
+                    quantifiable = false;
+                    break;
+                case L'.':
+                    atom = make(Node::Kind::Any);
+                    break;
+                case L'[':
+                    atom = this->char_class();
+                    break;
+                case L'(':
+                    atom = this->group(quantifiable);
+                    break;
+                case L'\\':
+                    atom = this->escape(quantifiable);
+                    break;
+                case L'*':
+                case L'+':
+                case L'?':
+                    fail("Nothing to repeat", start);
+                case L'{': {
+                    unsigned min, max;
+                    if (this->braces(min, max)) fail("Nothing to repeat", start);
+                    atom = make(Node::Kind::Char);
+                    atom.ch = ch;
+                    break;
+                }
+                default:
+                    atom = make(Node::Kind::Char);
+                    atom.ch = ch;
+                    break;
+            }
+
+            return this->quantifier(std::move(atom), quantifiable);
+        }
+
+        Node sequence() {
+            Node node = make(Node::Kind::Concat);
+
+            while (!this->at_end() && this->peek() != L'|' && this->peek() != L')') {
+                node.children.push_back(this->term());
+            }
+
+            if (node.children.empty()) return make(Node::Kind::Empty);
+            if (node.children.size() == 1) return std::move(node.children.front());
+            return node;
+        }
+
+        Node alternation() {
+            Node first = this->sequence();
+            if (this->at_end() || this->peek() != L'|') return first;
+
+            Node node = make(Node::Kind::Alternate);
+            node.children.push_back(std::move(first));
+            while (this->eat(L'|')) {
+                node.children.push_back(this->sequence());
+            }
+            return node;
+        }
+
+    public:
+        unsigned groups;
+
+        explicit Parser(std::wstring_view src) noexcept : src(src), pos(0), max_backref(0), groups(0) {}
+
+        Node parse() {
+            Node result = this->alternation();
+
+            if (!this->at_end()) fail("Unmatched ')'", this->pos);
+            if (this->max_backref > this->groups) fail("Back reference to non-existing group", 0);
+
+            return result;
+        }
+};
+
+static bool is_nullable(const Node& node) noexcept {
+    switch (node.kind) {
+        case Node::Kind::Char:
+        case Node::Kind::Any:
+        case Node::Kind::Class:
+            return false;
+        case Node::Kind::Group:
+            return is_nullable(node.children.front());
+        case Node::Kind::Concat:
+            return std::all_of(node.children.begin(), node.children.end(), is_nullable);
+        case Node::Kind::Alternate:
+            return std::any_of(node.children.begin(), node.children.end(), is_nullable);
+        case Node::Kind::Repeat:
+            return node.min == 0 || is_nullable(node.children.front());
+        default:
+            return true;
+    }
+}
+
+class Regex::Compiler {
+    private:
+        Regex& regex;
+
+        size_t emit(Op op, unsigned n = 0, wchar_t ch = 0) {
+            if (this->regex.program.size() >= MAX_PROGRAM_SIZE) throw std::runtime_error("Pattern is too large");
+
+            this->regex.program.push_back(Inst{op, op, true, ch, n, 0, 0});
+            return this->regex.program.size() - 1;
+        }
+
+        size_t here() const noexcept {
+            return this->regex.program.size();
+        }
+
+        Inst& at(size_t idx) noexcept {
+            return this->regex.program[idx];
+        }
+
+        void repeat(const Node& node) {
+            const Node& child = node.children.front();
+
+            if (child.kind == Node::Kind::Char || child.kind == Node::Kind::Any || child.kind == Node::Kind::Class) {
+                const size_t repeat = this->emit(Op::Repeat, 0, child.ch);
+                if (child.kind == Node::Kind::Class) {
+                    this->regex.classes.push_back(child.cls);
+                    this->regex.classes.back().prepare();
+                    this->at(repeat).n = static_cast<unsigned>(this->regex.classes.size() - 1);
+                }
+                this->at(repeat).sub = child.kind == Node::Kind::Char ? Op::Char : child.kind == Node::Kind::Any ? Op::Any : Op::Class;
+                this->at(repeat).greedy = node.greedy;
+                this->at(repeat).x = node.min;
+                this->at(repeat).y = node.max == Node::UNBOUNDED ? npos : node.max;
+                return;
+            }
+
+            for (unsigned idx = 0; idx < node.min; idx++) {
+                this->compile(child);
+            }
+
+            if (node.max == Node::UNBOUNDED) {
+                const size_t loop = this->emit(Op::Split);
+                const size_t body = this->here();
+                //Loop which body can match empty string would spin forever.
+                const bool guard = is_nullable(child);
+                const unsigned reg = guard ? this->regex.loop_count++ : 0;
+
+                if (guard) this->emit(Op::Mark, reg);
+                this->compile(child);
+                if (guard) this->emit(Op::Check, reg);
+                this->at(this->emit(Op::Jump)).x = loop;
+
+                const size_t out = this->here();
+                this->at(loop).x = node.greedy ? body : out;
+                this->at(loop).y = node.greedy ? out : body;
+            }
+            else {
+                std::vector<size_t> splits;
+                std::vector<size_t> bodies;
+                for (unsigned idx = node.min; idx < node.max; idx++) {
+                    splits.push_back(this->emit(Op::Split));
+                    bodies.push_back(this->here());
+                    this->compile(child);
+                }
+
+                const size_t out = this->here();
+                for (size_t idx = 0; idx < splits.size(); idx++) {
+                    this->at(splits[idx]).x = node.greedy ? bodies[idx] : out;
+                    this->at(splits[idx]).y = node.greedy ? out : bodies[idx];
+                }
+            }
+        }
+
+    public:
+        explicit Compiler(Regex& regex) noexcept : regex(regex) {}
+
+        void compile(const Node& node) {
+            switch (node.kind) {
+                case Node::Kind::Empty:
+                    break;
+                case Node::Kind::Char:
+                    this->emit(Op::Char, 0, node.ch);
+                    break;
+                case Node::Kind::Any:
+                    this->emit(Op::Any);
+                    break;
+                case Node::Kind::Class:
+                    this->regex.classes.push_back(node.cls);
+                    this->regex.classes.back().prepare();
+                    this->emit(Op::Class, static_cast<unsigned>(this->regex.classes.size() - 1));
+                    break;
+                case Node::Kind::Begin:
+                    this->emit(Op::Begin);
+                    break;
+                case Node::Kind::End:
+                    this->emit(Op::End);
+                    break;
+                case Node::Kind::WordBoundary:
+                    this->emit(Op::WordBoundary);
+                    break;
+                case Node::Kind::NotWordBoundary:
+                    this->emit(Op::NotWordBoundary);
+                    break;
+                case Node::Kind::Group:
+                    this->emit(Op::Save, node.index * 2);
+                    this->compile(node.children.front());
+                    this->emit(Op::Save, node.index * 2 + 1);
+                    break;
+                case Node::Kind::Concat:
+                    for (const auto& child : node.children) {
+                        this->compile(child);
+                    }
+                    break;
+                case Node::Kind::Alternate: {
+                    std::vector<size_t> jumps;
+                    for (size_t idx = 0; idx < node.children.size(); idx++) {
+                        if (idx + 1 < node.children.size()) {
+                            const size_t split = this->emit(Op::Split);
+                            this->at(split).x = split + 1;
+                            this->compile(node.children[idx]);
+                            jumps.push_back(this->emit(Op::Jump));
+                            this->at(split).y = this->here();
+                        }
+                        else {
+                            this->compile(node.children[idx]);
+                        }
+                    }
+                    for (const auto jump : jumps) {
+                        this->at(jump).x = this->here();
+                    }
+                    break;
+                }
+                case Node::Kind::Repeat:
+                    this->repeat(node);
+                    break;
+                case Node::Kind::Backref:
+                    this->emit(Op::Backref, node.index);
+                    break;
+                case Node::Kind::Lookahead:
+                case Node::Kind::NegativeLookahead: {
+                    const size_t look = this->emit(Op::Look, node.kind == Node::Kind::NegativeLookahead ? 1 : 0);
+                    this->compile(node.children.front());
+                    this->emit(Op::LookMatch);
+                    this->at(look).x = look + 1;
+                    this->at(look).y = this->here();
+                    break;
+                }
+            }
+        }
+};
+
+///Maximum number of backtracking frames, after which search is considered exhausted.
+static constexpr size_t MAX_FRAMES = 1 << 20;
+///Backtracking stack bigger than that is not kept for next search.
+static constexpr size_t MAX_KEPT_FRAMES = 1 << 14;
+
+///Backtracking executor.
+///
+///Instead of recursion, alternatives and undo records are pushed onto explicit stack.
+class Regex::Executor {
+    private:
+        struct Frame {
+            enum class Kind : uint8_t {
+                ///Continue at `pc` with `pos`.
+                Branch,
+                ///Restore capture `aux` to `pos`.
+                Capture,
+                ///Restore loop register `aux` to `pos`.
+                Register,
+                ///Restore all captures from last snapshot.
+                Snapshot,
+                ///Greedy Repeat gives back one character: continue at `pc` with `pos - 1` unless it is below `aux`.
+                Greedy,
+                ///Lazy Repeat `pc` takes one more character at `pos` unless it reaches `aux`.
+                Lazy,
+            };
+
+            Kind kind;
+            size_t pc;
+            size_t pos;
+            size_t aux;
+        };
+
+        ///Buffers of executor, which are reused by subsequent searches on the same thread.
+        struct Scratch {
+            std::vector<size_t> registers;
+            std::vector<Frame> stack;
+            std::vector<Captures> snapshots;
+        };
+
+        static Scratch& scratch() noexcept {
+            static thread_local Scratch instance;
+            return instance;
+        }
+
+        const Regex& regex;
+        std::wstring_view text;
+        Captures& captures;
+        Limits& limits;
+        std::vector<size_t>& registers;
+        std::vector<Frame>& stack;
+        std::vector<Captures>& snapshots;
+
+        bool is_boundary(size_t pos) const noexcept {
+            const bool before = pos > 0 && is_word(this->text[pos - 1]);
+            const bool after = pos < this->text.size() && is_word(this->text[pos]);
+            return before != after;
+        }
+
+        bool accepts(const Inst& inst, wchar_t ch) const noexcept {
+            switch (inst.sub) {
+                case Op::Char: return ch == inst.ch;
+                case Op::Any: return !is_line_terminator(ch);
+                default: return this->regex.classes[inst.n].matches(ch);
+            }
+        }
+
+        bool push(Frame::Kind kind, size_t pc, size_t pos, size_t aux) {
+            if (this->stack.size() >= MAX_FRAMES) return false;
+            this->stack.push_back(Frame{kind, pc, pos, aux});
+            return true;
+        }
+
+        ///Pops frames until next alternative.
+        ///
+        ///@retval false If there is no alternative left above `base`.
+        bool backtrack(size_t base, size_t& pc, size_t& pos) {
+            while (this->stack.size() > base) {
+                const Frame frame = this->stack.back();
+                this->stack.pop_back();
+
+                switch (frame.kind) {
+                    case Frame::Kind::Branch:
+                        pc = frame.pc;
+                        pos = frame.pos;
+                        return true;
+                    case Frame::Kind::Capture:
+                        this->captures[frame.aux] = frame.pos;
+                        break;
+                    case Frame::Kind::Register:
+                        this->registers[frame.aux] = frame.pos;
+                        break;
+                    case Frame::Kind::Snapshot:
+                        this->captures.swap(this->snapshots.back());
+                        this->snapshots.pop_back();
+                        break;
+                    case Frame::Kind::Greedy:
+                        pc = frame.pc;
+                        pos = frame.pos - 1;
+                        if (pos > frame.aux) this->stack.push_back(Frame{frame.kind, frame.pc, pos, frame.aux});
+                        return true;
+                    case Frame::Kind::Lazy: {
+                        const Inst& inst = this->regex.program[frame.pc];
+                        this->horizon = std::max(this->horizon, frame.pos);
+                        if (frame.pos >= this->text.size() || !this->accepts(inst, this->text[frame.pos])) break;
+
+                        pc = frame.pc + 1;
+                        pos = frame.pos + 1;
+                        if (pos < frame.aux) this->stack.push_back(Frame{frame.kind, frame.pc, pos, frame.aux});
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        ///Stops run, discarding frames above `base`.
+        bool finish(size_t base, size_t snapshot_base, bool result) {
+            this->stack.resize(base);
+            this->snapshots.resize(snapshot_base);
+            return result;
+        }
+
+    public:
+        size_t start;
+        bool not_empty;
+        bool exhausted;
+        ///Maximum position inspected so far.
+        size_t horizon;
+
+        Executor(const Regex& regex, std::wstring_view text, Captures& captures, Limits& limits) :
+            regex(regex),
+            text(text),
+            captures(captures),
+            limits(limits),
+            registers(scratch().registers),
+            stack(scratch().stack),
+            snapshots(scratch().snapshots),
+            start(0),
+            not_empty(false),
+            exhausted(false),
+            horizon(0)
+        {
+            this->registers.assign(regex.loop_count, npos);
+            this->stack.clear();
+            this->snapshots.clear();
+        }
+
+        ~Executor() {
+            //Pathological search shouldn't leave thread with huge buffer.
+            if (this->stack.capacity() > MAX_KEPT_FRAMES) {
+                std::vector<Frame>().swap(this->stack);
+            }
+        }
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        ///Runs program from `pc` at `pos`.
+        ///
+        ///Nested runs are used only by lookahead, so depth is bounded by pattern.
+        bool run(size_t pc, size_t pos) {
+            const size_t base = this->stack.size();
+            const size_t snapshot_base = this->snapshots.size();
+
+            for (;;) {
+                if (!this->limits.tick()) {
+                    this->exhausted = true;
+                    return this->finish(base, snapshot_base, false);
+                }
+
+                const Inst& inst = this->regex.program[pc];
+                bool ok = true;
+                this->horizon = std::max(this->horizon, pos);
+
+                switch (inst.op) {
+                    case Op::Char:
+                        ok = pos < this->text.size() && this->text[pos] == inst.ch;
+                        pos += 1;
+                        pc += 1;
+                        break;
+                    case Op::Any:
+                        ok = pos < this->text.size() && !is_line_terminator(this->text[pos]);
+                        pos += 1;
+                        pc += 1;
+                        break;
+                    case Op::Class:
+                        ok = pos < this->text.size() && this->regex.classes[inst.n].matches(this->text[pos]);
+                        pos += 1;
+                        pc += 1;
+                        break;
+                    case Op::Begin:
+                        ok = pos == 0;
+                        pc += 1;
+                        break;
+                    case Op::End:
+                        ok = pos == this->text.size();
+                        pc += 1;
+                        break;
+                    case Op::WordBoundary:
+                        ok = this->is_boundary(pos);
+                        pc += 1;
+                        break;
+                    case Op::NotWordBoundary:
+                        ok = !this->is_boundary(pos);
+                        pc += 1;
+                        break;
+                    case Op::Split:
+                        ok = this->push(Frame::Kind::Branch, inst.y, pos, 0);
+                        pc = inst.x;
+                        break;
+                    case Op::Jump:
+                        pc = inst.x;
+                        break;
+                    case Op::Save:
+                        ok = this->push(Frame::Kind::Capture, 0, this->captures[inst.n], inst.n);
+                        this->captures[inst.n] = pos;
+                        pc += 1;
+                        break;
+                    case Op::Backref: {
+                        const size_t group_start = this->captures[inst.n * 2];
+                        const size_t group_end = this->captures[inst.n * 2 + 1];
+                        //Group which did not participate matches empty string.
+                        if (group_start != npos && group_end != npos && group_end > group_start) {
+                            const size_t len = group_end - group_start;
+                            ok = this->text.size() - pos >= len && this->text.compare(pos, len, this->text.substr(group_start, len)) == 0;
+                            this->horizon = std::max(this->horizon, pos + len);
+                            pos += len;
+                        }
+                        pc += 1;
+                        break;
+                    }
+                    case Op::Mark:
+                        ok = this->push(Frame::Kind::Register, 0, this->registers[inst.n], inst.n);
+                        this->registers[inst.n] = pos;
+                        pc += 1;
+                        break;
+                    case Op::Check:
+                        ok = this->registers[inst.n] != pos;
+                        pc += 1;
+                        break;
+                    case Op::Look: {
+                        Captures saved = this->captures;
+                        const bool found = this->run(inst.x, pos);
+                        if (this->exhausted) return this->finish(base, snapshot_base, false);
+
+                        ok = found == (inst.n == 0);
+                        if (!ok) {
+                            this->captures.swap(saved);
+                        }
+                        else if (found) {
+                            //Successful lookahead keeps its captures, restore them on backtracking.
+                            this->snapshots.push_back(std::move(saved));
+                            ok = this->push(Frame::Kind::Snapshot, 0, 0, 0);
+                        }
+                        pc = inst.y;
+                        break;
+                    }
+                    case Op::LookMatch:
+                        return this->finish(base, snapshot_base, true);
+                    case Op::Repeat: {
+                        const size_t min = inst.x;
+                        const size_t max = inst.y == npos ? npos : pos + inst.y;
+                        size_t end = pos;
+
+                        if (inst.greedy) {
+                            const size_t limit = std::min(max, this->text.size());
+                            while (end < limit && this->accepts(inst, this->text[end])) {
+                                end += 1;
+                                if (!this->limits.tick()) {
+                                    this->exhausted = true;
+                                    return this->finish(base, snapshot_base, false);
+                                }
+                            }
+
+                            this->horizon = std::max(this->horizon, end);
+                            ok = end - pos >= min;
+                            if (ok && end - pos > min) ok = this->push(Frame::Kind::Greedy, pc + 1, end, pos + min);
+                        }
+                        else {
+                            while (end - pos < min && end < this->text.size() && this->accepts(inst, this->text[end])) {
+                                end += 1;
+                            }
+                            this->horizon = std::max(this->horizon, end);
+
+                            ok = end - pos >= min;
+                            if (ok && end < max) ok = this->push(Frame::Kind::Lazy, pc, end, max);
+                        }
+
+                        pos = end;
+                        pc += 1;
+                        break;
+                    }
+                    case Op::Match:
+                        ok = !this->not_empty || pos != this->start;
+                        if (ok) {
+                            this->captures[1] = pos;
+                            return this->finish(base, snapshot_base, true);
+                        }
+                        break;
+                }
+
+                if (!ok) {
+                    if (this->stack.size() >= MAX_FRAMES) {
+                        this->exhausted = true;
+                        return this->finish(base, snapshot_base, false);
+                    }
+                    if (!this->backtrack(base, pc, pos)) return this->finish(base, snapshot_base, false);
+                }
+            }
+        }
+};
+
+Regex::Limits::Limits(const Budget& budget) noexcept :
+    steps_left(0),
+    has_steps(false),
+    has_deadline(false),
+    cancellation(nullptr),
+    used(0)
+{
+    this->restrict(budget);
+}
+
+void Regex::Limits::cancel_on(const Cancellation& cancellation) noexcept {
+    this->cancellation = &cancellation;
+}
+
+bool Regex::Limits::is_cancelled() const noexcept {
+    return this->cancellation != nullptr && this->cancellation->is_cancelled();
+}
+
+void Regex::Limits::restrict(const Budget& budget) noexcept {
+    if (budget.steps != 0) {
+        this->steps_left = this->has_steps ? std::min(this->steps_left, budget.steps) : budget.steps;
+        this->has_steps = true;
+    }
+
+    if (budget.time.count() != 0) {
+        const auto deadline = std::chrono::steady_clock::now() + budget.time;
+        this->deadline = this->has_deadline ? std::min(this->deadline, deadline) : deadline;
+        this->has_deadline = true;
+    }
+}
+
+uint64_t Regex::Limits::steps() const noexcept {
+    return this->used;
+}
+
+void Regex::Limits::charge(const Limits& nested) noexcept {
+    const uint64_t spent = nested.used - this->used;
+    this->used = nested.used;
+
+    if (this->has_steps) {
+        this->steps_left = spent >= this->steps_left ? 0 : this->steps_left - spent;
+    }
+}
+
+bool Regex::Limits::is_exhausted() const noexcept {
+    if (this->has_steps && this->steps_left == 0) return true;
+    if (this->is_cancelled()) return true;
+    if (this->has_deadline && std::chrono::steady_clock::now() >= this->deadline) return true;
+    return false;
+}
+
+bool Regex::Limits::tick() noexcept {
+    this->used += 1;
+
+    if (this->has_steps) {
+        if (this->steps_left == 0) return false;
+        this->steps_left -= 1;
+    }
+
+    if ((this->used & DEADLINE_CHECK_MASK) == 0) {
+        if (this->has_deadline && std::chrono::steady_clock::now() >= this->deadline) return false;
+        if (this->is_cancelled()) return false;
+    }
+
+    return true;
+}
+
+Regex::Regex(std::wstring_view pattern) :
+    pattern(pattern),
+    group_count(0),
+    loop_count(0),
+    anchored(false),
+    line_anchored(false)
+{
+    Parser parser(this->pattern);
+    this->root = parser.parse();
+    this->group_count = parser.groups;
+
+    Compiler compiler(*this);
+    compiler.compile(this->root);
+    this->program.push_back(Inst{Op::Match, Op::Match, true, 0, 0, 0, 0});
+
+    this->anchored = this->root.kind == Node::Kind::Begin ||
+                     (this->root.kind == Node::Kind::Concat && this->root.children.front().kind == Node::Kind::Begin);
+
+    //Attempt at any later position within the same line would try only subset of what `.*` has already tried.
+    const Inst& first = this->program.front();
+    this->line_anchored = first.op == Op::Repeat && first.sub == Op::Any && first.x == 0 && first.y == npos;
+}
+
+const std::wstring& Regex::source() const noexcept {
+    return this->pattern;
+}
+
+const Node& Regex::ast() const noexcept {
+    return this->root;
+}
+
+unsigned Regex::groups() const noexcept {
+    return this->group_count;
+}
+
+bool Regex::is_anchored() const noexcept {
+    return this->anchored;
+}
+
+bool Regex::is_line_anchored() const noexcept {
+    return this->line_anchored;
+}
+
+Regex::Status Regex::search(std::wstring_view text, size_t from, bool not_empty, Captures& captures, Limits& limits) const {
+    Trace trace;
+    return this->search(text, from, not_empty, captures, limits, trace);
+}
+
+Regex::Status Regex::search(std::wstring_view text, size_t from, bool not_empty, Captures& captures, Limits& limits, Trace& trace) const {
+    captures.assign((this->group_count + 1) * 2, npos);
+    trace.horizon = text.size();
+    trace.settled = from;
+
+    if (from > text.size()) return Status::NoMatch;
+
+    //Match has to start with this character.
+    const Inst& first = this->program.front();
+    const bool has_first_char = first.op == Op::Char;
+    const bool has_first_class = first.op == Op::Class;
+
+    Executor executor(*this, text, captures, limits);
+    //Attempts before `pos` failed without looking at end of text, so they would fail on longer text too.
+    const auto settle = [&](size_t pos) {
+        if (executor.horizon < text.size()) trace.settled = pos;
+    };
+
+    for (size_t start = from; start <= text.size(); start++) {
+        if (this->anchored && start != 0) {
+            settle(text.size());
+            break;
+        }
+
+        if (has_first_char) {
+            const wchar_t* found = start < text.size() ? std::wmemchr(text.data() + start, first.ch, text.size() - start) : nullptr;
+            if (found == nullptr) {
+                settle(text.size());
+                break;
+            }
+            start = static_cast<size_t>(found - text.data());
+        }
+        else if (has_first_class) {
+            const CharClass& cls = this->classes[first.n];
+            while (start < text.size() && !cls.matches(text[start])) {
+                start += 1;
+            }
+            if (start == text.size()) {
+                settle(text.size());
+                break;
+            }
+        }
+
+        settle(start);
+        executor.start = start;
+        executor.not_empty = not_empty && start == from;
+        captures[0] = start;
+
+        if (executor.run(0, start)) {
+            trace.horizon = executor.horizon;
+            return Status::Match;
+        }
+        if (executor.exhausted) return Status::Exhausted;
+
+        if (this->line_anchored) {
+            while (start < text.size() && !is_line_terminator(text[start])) {
+                start += 1;
+            }
+            executor.horizon = std::max(executor.horizon, start);
+        }
+    }
+
+    trace.horizon = executor.horizon;
+    captures[0] = npos;
+    return Status::NoMatch;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+
+namespace text {
+    /**
+     * Set of characters in `[...]` or escapes like `\s`.
+     */
+    struct CharClass {
+        ///Inclusive ranges of characters.
+        std::vector<std::pair<wchar_t, wchar_t>> ranges;
+        bool negated = false;
+        ///Bitmap of `ranges` within Basic Multilingual Plane, filled by `prepare()`.
+        std::vector<uint64_t> table;
+
+        ///Builds lookup table, so that matching doesn't need to go over ranges.
+        void prepare();
+        bool matches(wchar_t ch) const noexcept;
+    };
+
+    /**
+     * Parsed regular expression.
+     */
+    struct Node {
+        enum class Kind {
+            ///Matches empty string.
+            Empty,
+            ///Matches `ch`.
+            Char,
+            ///Matches anything except line terminators.
+            Any,
+            ///Matches `cls`.
+            Class,
+            ///`^`
+            Begin,
+            ///`$`
+            End,
+            ///`\b`
+            WordBoundary,
+            ///`\B`
+            NotWordBoundary,
+            ///Capturing group `index` with single child.
+            Group,
+            ///Sequence of children.
+            Concat,
+            ///Alternation of children.
+            Alternate,
+            ///Single child repeated from `min` to `max` times.
+            Repeat,
+            ///Back reference to group `index`.
+            Backref,
+            ///`(?=...)` with single child.
+            Lookahead,
+            ///`(?!...)` with single child.
+            NegativeLookahead,
+        };
+
+        ///Indicates unbounded `max` of Repeat.
+        static constexpr unsigned UNBOUNDED = static_cast<unsigned>(-1);
+
+        Kind kind = Kind::Empty;
+        wchar_t ch = 0;
+        CharClass cls;
+        unsigned index = 0;
+        unsigned min = 0;
+        unsigned max = 0;
+        bool greedy = true;
+        std::vector<Node> children;
+    };
+
+    /**
+     * Request to abort work, which result is no longer needed, like clean of text, that is superseded by newer one.
+     *
+     * Set by any thread and checked between rules and periodically by matcher.
+     */
+    class Cancellation {
+        private:
+            std::atomic<bool> is_set;
+
+        public:
+            Cancellation() noexcept : is_set(false) {}
+
+            void cancel() noexcept {
+                this->is_set.store(true, std::memory_order_relaxed);
+            }
+
+            ///Makes token usable for new work.
+            void reset() noexcept {
+                this->is_set.store(false, std::memory_order_relaxed);
+            }
+
+            bool is_cancelled() const noexcept {
+                return this->is_set.load(std::memory_order_relaxed);
+            }
+    };
+
+    /**
+     * Limits of single matcher run.
+     */
+    struct Budget {
+        ///Maximum number of matcher steps. 0 means unlimited.
+        uint64_t steps = 0;
+        ///Maximum time. 0 means unlimited.
+        std::chrono::microseconds time{0};
+
+        bool is_unlimited() const noexcept {
+            return this->steps == 0 && this->time.count() == 0;
+        }
+    };
+
+    /**
+     * Regular expression engine.
+     *
+     * Supports ECMAScript syntax, same as `std::regex` by default, except of
+     * case insensitive matching and multiline mode.
+     *
+     * Unlike `std::regex`, matching is always performed within limits, which
+     * allows to abort pathological patterns instead of hanging.
+     *
+     * Matcher doesn't recurse, backtracking state is kept on heap instead.
+     * Repetition of single character matcher, like `.*`, takes constant space,
+     * so long text doesn't make state to grow.
+     */
+    class Regex {
+        public:
+            ///Result of matching.
+            enum class Status {
+                Match,
+                NoMatch,
+                ///Budget has been exceeded before result has been found.
+                Exhausted,
+            };
+
+            /**
+             * Part of text search depended on.
+             *
+             * Allows to resume search once text is extended.
+             */
+            struct Trace {
+                ///Maximum inspected position. If it is `text.size()`, result may change once text is extended.
+                size_t horizon;
+                ///Attempts before this position fail regardless of text beyond its end,
+                ///so search of extended text may start from here.
+                size_t settled;
+            };
+
+            ///Capture group positions.
+            ///
+            ///Group `n` occupies `[2n, 2n + 1]`, `npos` for unmatched group.
+            typedef std::vector<size_t> Captures;
+
+            /**
+             * Limits shared by consecutive searches.
+             */
+            class Limits {
+                friend class Regex;
+
+                private:
+                    uint64_t steps_left;
+                    bool has_steps;
+                    std::chrono::steady_clock::time_point deadline;
+                    bool has_deadline;
+                    const Cancellation* cancellation;
+                    uint64_t used;
+
+                public:
+                    ///Starts limits using budget from now.
+                    explicit Limits(const Budget& budget) noexcept;
+
+                    ///Makes limits exceeded once token is cancelled.
+                    void cancel_on(const Cancellation& cancellation) noexcept;
+                    ///@return Whether limits are exceeded due to cancellation.
+                    bool is_cancelled() const noexcept;
+
+                    ///Restricts limits further by budget from now.
+                    void restrict(const Budget& budget) noexcept;
+
+                    ///@return Number of steps made so far.
+                    uint64_t steps() const noexcept;
+
+                    ///Accounts steps made by limits copied from this one.
+                    void charge(const Limits& nested) noexcept;
+
+                    ///@return Whether there is nothing left to spend.
+                    bool is_exhausted() const noexcept;
+
+                    ///Accounts single step.
+                    ///
+                    ///@retval false If limits are exceeded.
+                    bool tick() noexcept;
+            };
+
+            ///Parses pattern
+            ///
+            ///@throws runtime_error When pattern is invalid.
+            explicit Regex(std::wstring_view pattern);
+
+            ///@return Original pattern.
+            const std::wstring& source() const noexcept;
+            ///@return Parsed pattern.
+            const Node& ast() const noexcept;
+            ///@return Number of capture groups, excluding whole match.
+            unsigned groups() const noexcept;
+            ///@return Whether pattern can match only at the beginning of text.
+            bool is_anchored() const noexcept;
+            ///@return Whether pattern starts with `.*`, so it is not retried within the same line.
+            bool is_line_anchored() const noexcept;
+
+            /**
+             * Looks up first match starting from `from`.
+             *
+             * @param[in] text Text to search.
+             * @param[in] from Position to start search from.
+             * @param[in] not_empty Whether to reject empty match at `from`.
+             * @param[out] captures Positions of match.
+             * @param[in,out] limits Limits of search.
+             */
+            Status search(std::wstring_view text, size_t from, bool not_empty, Captures& captures, Limits& limits) const;
+            ///Same as `search`, but also reports part of text result depends on.
+            Status search(std::wstring_view text, size_t from, bool not_empty, Captures& captures, Limits& limits, Trace& trace) const;
+
+        private:
+            enum class Op : uint8_t {
+                Char,
+                Any,
+                Class,
+                Begin,
+                End,
+                WordBoundary,
+                NotWordBoundary,
+                ///Tries `x` then `y`.
+                Split,
+                Jump,
+                ///Stores position into capture `n`.
+                Save,
+                Backref,
+                ///Stores position into loop register `n`.
+                Mark,
+                ///Fails if position hasn't moved since loop register `n`.
+                Check,
+                ///Runs lookahead at `x`, continues at `y`. `n` is non-zero for negative one.
+                Look,
+                ///End of lookahead.
+                LookMatch,
+                ///Repeats single character matcher `sub` from `x` to `y` times.
+                ///
+                ///Backtracks by position, so it needs constant memory regardless of text length.
+                Repeat,
+                Match,
+            };
+
+            struct Inst {
+                Op op;
+                ///Single character matcher of Repeat: Char, Any or Class.
+                Op sub;
+                ///Whether Repeat is greedy.
+                bool greedy;
+                wchar_t ch;
+                unsigned n;
+                size_t x;
+                size_t y;
+            };
+
+            class Compiler;
+            class Executor;
+
+            std::wstring pattern;
+            Node root;
+            unsigned group_count;
+            unsigned loop_count;
+            std::vector<CharClass> classes;
+            std::vector<Inst> program;
+            bool anchored;
+            ///Pattern starts with `.*`, so it cannot match within line after failed attempt.
+            bool line_anchored;
+    };
+}
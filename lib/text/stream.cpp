@@ -0,0 +1,52 @@
+#include "stream.hpp"
+
+using namespace text;
+
+StreamCleaner::StreamCleaner(const Cleaner& cleaner, Callback&& callback) : cleaner(cleaner), callback(std::move(callback)) {}
+
+void StreamCleaner::emit(std::wstring_view line) {
+    const bool is_crlf = !line.empty() && line.back() == L'\r';
+    const auto content = is_crlf ? line.substr(0, line.size() - 1) : line;
+
+    auto result = this->cleaner.clean(std::wstring(content));
+    if (!result.has_value()) {
+        this->callback(line);
+        return;
+    }
+
+    //Line end is kept as it was.
+    if (is_crlf) result->push_back(L'\r');
+    this->callback(*result);
+}
+
+void StreamCleaner::feed(std::wstring_view chunk) {
+    size_t start = 0;
+
+    for (size_t end = chunk.find(L'\n'); end != std::wstring_view::npos; end = chunk.find(L'\n', start)) {
+        //Complete lines within chunk are cleaned without copying them into buffer.
+        if (this->pending.empty()) {
+            this->emit(chunk.substr(start, end - start));
+        }
+        else {
+            this->pending.append(chunk.substr(start, end - start));
+            this->emit(this->pending);
+            //Keeps capacity, so that buffer is allocated only for the longest line.
+            this->pending.clear();
+        }
+
+        start = end + 1;
+    }
+
+    this->pending.append(chunk.substr(start));
+}
+
+void StreamCleaner::finish() {
+    if (this->pending.empty()) return;
+
+    this->emit(this->pending);
+    this->pending.clear();
+}
+
+size_t StreamCleaner::pending_size() const noexcept {
+    return this->pending.size();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <functional>
+
+#include "text.hpp"
+
+namespace text {
+    /**
+     * Push-style cleaner of text, that arrives in chunks.
+     *
+     * Text is split into lines by `\n`, each line is cleaned on its own as soon as its end is seen,
+     * so rules see exactly the same text as with `Cleaner::clean` on single line.
+     * Trailing `\r` is considered as part of line terminator, so rules do not see it,
+     * but it is kept at the end of cleaned line.
+     *
+     * Only incomplete line is kept between chunks, so memory is bounded by the longest line.
+     */
+    class StreamCleaner {
+        public:
+            ///Receives cleaned line without `\n`.
+            ///
+            ///View is valid only during call.
+            typedef std::function<void(std::wstring_view)> Callback;
+
+        private:
+            const Cleaner& cleaner;
+            Callback callback;
+            ///Incomplete line from previous chunks.
+            std::wstring pending;
+
+            void emit(std::wstring_view line);
+
+        public:
+            ///Cleaner must outlive stream.
+            StreamCleaner(const Cleaner& cleaner, Callback&& callback);
+
+            ///Cleans every line completed by chunk.
+            void feed(std::wstring_view chunk);
+            ///Cleans last line, if it is not terminated.
+            void finish();
+            ///@return Number of characters waiting for line end.
+            size_t pending_size() const noexcept;
+    };
+}
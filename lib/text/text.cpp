@@ -1,45 +1,448 @@
-#include <locale>
-#include <codecvt>
+#include <cwchar>
+#include <stdexcept>
 
 #include "text.hpp"
 
 using namespace text;
 
 #include <iostream>
-std::wstring text::to_wide_string(const std::string& str) {
-    std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-    std::wstring result = converter.from_bytes(str);
+//Conversion produces UTF-16 code units regardless of size of wchar_t, same as codecvt_utf8_utf16,
+//but without going through locale machinery for each character.
+std::wstring text::to_wide_string(std::string_view str) {
+    std::wstring result;
+    result.reserve(str.size());
+
+    const auto invalid = []() {
+        return std::range_error("Invalid UTF-8 text");
+    };
+
+    const auto* cursor = reinterpret_cast<const unsigned char*>(str.data());
+    const auto* const end = cursor + str.size();
+    while (cursor < end) {
+        const unsigned char lead = *cursor;
+        if (lead < 0x80) {
+            result.push_back(static_cast<wchar_t>(lead));
+            cursor += 1;
+            continue;
+        }
+
+        size_t len = 0;
+        uint32_t code = 0;
+        uint32_t min = 0;
+        if ((lead & 0xE0) == 0xC0) {
+            len = 2;
+            code = lead & 0x1F;
+            min = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0) {
+            len = 3;
+            code = lead & 0x0F;
+            min = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0) {
+            len = 4;
+            code = lead & 0x07;
+            min = 0x10000;
+        }
+        else {
+            throw invalid();
+        }
+
+        if (static_cast<size_t>(end - cursor) < len) throw invalid();
+        for (size_t idx = 1; idx < len; idx++) {
+            if ((cursor[idx] & 0xC0) != 0x80) throw invalid();
+            code = code << 6 | (cursor[idx] & 0x3F);
+        }
+        //Overlong encoding, surrogate or out of Unicode range.
+        if (code < min || (code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF) throw invalid();
+        cursor += len;
+
+        if (code >= 0x10000) {
+            code -= 0x10000;
+            result.push_back(static_cast<wchar_t>(0xD800 + (code >> 10)));
+            result.push_back(static_cast<wchar_t>(0xDC00 + (code & 0x3FF)));
+        }
+        else {
+            result.push_back(static_cast<wchar_t>(code));
+        }
+    }
+
+    return result;
+}
+
+std::string text::to_utf8_string(std::wstring_view str) {
+    std::string result;
+    result.reserve(str.size() * 3);
+
+    for (size_t idx = 0; idx < str.size(); idx++) {
+        uint32_t code = static_cast<uint32_t>(str[idx]);
+
+        if (code < 0x80) {
+            result.push_back(static_cast<char>(code));
+            continue;
+        }
+
+        if (code >= 0xD800 && code <= 0xDBFF) {
+            if (idx + 1 == str.size()) throw std::range_error("Invalid UTF-16 text");
+            const uint32_t low = static_cast<uint32_t>(str[idx + 1]);
+            if (low < 0xDC00 || low > 0xDFFF) throw std::range_error("Invalid UTF-16 text");
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            idx += 1;
+        }
+        else if ((code >= 0xDC00 && code <= 0xDFFF) || code > 0x10FFFF) {
+            throw std::range_error("Invalid UTF-16 text");
+        }
+
+        if (code < 0x800) {
+            result.push_back(static_cast<char>(0xC0 | code >> 6));
+        }
+        else if (code < 0x10000) {
+            result.push_back(static_cast<char>(0xE0 | code >> 12));
+            result.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        }
+        else {
+            result.push_back(static_cast<char>(0xF0 | code >> 18));
+            result.push_back(static_cast<char>(0x80 | (code >> 12 & 0x3F)));
+            result.push_back(static_cast<char>(0x80 | (code >> 6 & 0x3F)));
+        }
+        result.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
 
     return result;
 }
 
-Replacer::Replacer(std::wregex&& pattern, std::wstring&& replacement) :
+bool text::contains(std::wstring_view haystack, std::wstring_view needle) noexcept {
+    if (needle.empty()) return true;
+    if (needle.size() > haystack.size()) return false;
+
+    const wchar_t first = needle.front();
+    const wchar_t* cursor = haystack.data();
+    //Last position at which needle can still fit.
+    const wchar_t* const last = haystack.data() + (haystack.size() - needle.size());
+
+    while (cursor <= last) {
+        cursor = std::wmemchr(cursor, first, static_cast<size_t>(last - cursor) + 1);
+        if (cursor == nullptr) return false;
+
+        if (std::wmemcmp(cursor + 1, needle.data() + 1, needle.size() - 1) == 0) return true;
+        cursor += 1;
+    }
+
+    return false;
+}
+
+Replacer::Replacer(Regex&& pattern, std::wstring&& replacement) :
     pattern(std::move(pattern)),
-    replacement(std::move(replacement))
+    terminal(false),
+    has_suffix(false)
 {
+    //Follows ECMAScript format rules, same as std::regex_replace
+    std::wstring literal;
+    const auto flush = [this, &literal]() {
+        if (!literal.empty()) {
+            this->replacement.push_back(Piece{Piece::Kind::Literal, std::move(literal), 0});
+            literal.clear();
+        }
+    };
+
+    for (size_t idx = 0; idx < replacement.size(); idx++) {
+        const wchar_t ch = replacement[idx];
+        if (ch != L'$' || idx + 1 == replacement.size()) {
+            literal.push_back(ch);
+            continue;
+        }
+
+        const wchar_t next = replacement[idx + 1];
+        if (next == L'$') {
+            literal.push_back(L'$');
+            idx += 1;
+        }
+        else if (next == L'&') {
+            flush();
+            this->replacement.push_back(Piece{Piece::Kind::Group, std::wstring(), 0});
+            idx += 1;
+        }
+        else if (next == L'`') {
+            flush();
+            this->replacement.push_back(Piece{Piece::Kind::Prefix, std::wstring(), 0});
+            idx += 1;
+        }
+        else if (next == L'\'') {
+            flush();
+            this->replacement.push_back(Piece{Piece::Kind::Suffix, std::wstring(), 0});
+            this->has_suffix = true;
+            idx += 1;
+        }
+        else if (next >= L'0' && next <= L'9') {
+            unsigned group = static_cast<unsigned>(next - L'0');
+            idx += 1;
+            if (idx + 1 < replacement.size() && replacement[idx + 1] >= L'0' && replacement[idx + 1] <= L'9') {
+                group = group * 10 + static_cast<unsigned>(replacement[idx + 1] - L'0');
+                idx += 1;
+            }
+
+            //Non-existing group is replaced with nothing.
+            if (group <= this->pattern.groups()) {
+                flush();
+                this->replacement.push_back(Piece{Piece::Kind::Group, std::wstring(), group});
+            }
+        }
+        else {
+            literal.push_back(L'$');
+        }
+    }
+    flush();
 }
 
 std::wstring Replacer::replace(const std::wstring& str) const {
-    return std::regex_replace(str, this->pattern, this->replacement);
+    std::wstring result(str);
+    Regex::Limits limits((Budget()));
+    (void)this->apply(result, limits);
+    return result;
+}
+
+void Replacer::substitute(std::wstring& result, const std::wstring& str, const Regex::Captures& captures, size_t tail) const {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    const size_t match_start = captures[0];
+    const size_t match_end = captures[1];
+
+    result.append(str, tail, match_start - tail);
+    for (const auto& piece : this->replacement) {
+        switch (piece.kind) {
+            case Piece::Kind::Literal:
+                result.append(piece.literal);
+                break;
+            case Piece::Kind::Group: {
+                const size_t group_start = captures[piece.group * 2];
+                const size_t group_end = captures[piece.group * 2 + 1];
+                if (group_start != npos && group_end != npos && group_end > group_start) {
+                    result.append(str, group_start, group_end - group_start);
+                }
+                break;
+            }
+            case Piece::Kind::Prefix:
+                result.append(str, tail, match_start - tail);
+                break;
+            case Piece::Kind::Suffix:
+                result.append(str, match_end, npos);
+                break;
+        }
+    }
+}
+
+Regex::Status Replacer::apply(std::wstring& str, Regex::Limits& limits) const {
+    std::wstring buffer;
+    return this->apply(str, buffer, limits);
+}
+
+Regex::Status Replacer::apply(std::wstring& str, std::wstring& result, Regex::Limits& limits) const {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    Regex::Captures captures;
+    bool matched = false;
+    bool not_empty = false;
+    size_t pos = 0;
+    size_t tail = 0;
+
+    for (;;) {
+        const auto status = this->pattern.search(str, pos, not_empty, captures, limits);
+        if (status == Regex::Status::Exhausted) return status;
+        if (status == Regex::Status::NoMatch) break;
+
+        if (!matched) {
+            //Typically rule removes a bit of text, so avoid growing result many times.
+            result.clear();
+            result.reserve(str.size());
+            matched = true;
+        }
+
+        this->substitute(result, str, captures, tail);
+        tail = captures[1];
+
+        //Same as regex_iterator: after empty match try to find non-empty one at the same position.
+        pos = captures[1];
+        not_empty = captures[0] == captures[1];
+    }
+
+    if (!matched) return Regex::Status::NoMatch;
+
+    result.append(str, tail, npos);
+    str.swap(result);
+    return Regex::Status::Match;
+}
+
+Regex::Status Replacer::apply(const std::wstring& str, std::wstring& result, Regex::Limits& limits, Progress& progress) const {
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    Regex::Captures captures;
+    Regex::Trace trace;
+    bool matched = progress.matched;
+    bool not_empty = progress.not_empty;
+    size_t pos = progress.pos;
+    size_t tail = progress.tail;
+    //Whether everything so far doesn't depend on end of text.
+    bool stable = true;
+
+    const auto settle = [&]() {
+        if (!stable) return;
+        progress.not_empty = not_empty && trace.settled == pos;
+        progress.pos = trace.settled;
+        stable = false;
+    };
+
+    result.resize(progress.output);
+    result.reserve(str.size());
+
+    for (;;) {
+        const auto status = this->pattern.search(str, pos, not_empty, captures, limits, trace);
+        if (status == Regex::Status::Exhausted) return status;
+        if (status == Regex::Status::NoMatch) {
+            settle();
+            break;
+        }
+
+        matched = true;
+        this->substitute(result, str, captures, tail);
+        tail = captures[1];
+
+        const bool is_final = trace.horizon >= str.size() || this->has_suffix;
+        if (is_final) settle();
+
+        pos = captures[1];
+        not_empty = captures[0] == captures[1];
+
+        if (stable) {
+            progress.tail = tail;
+            progress.pos = pos;
+            progress.output = result.size();
+            progress.not_empty = not_empty;
+            progress.matched = true;
+        }
+    }
+
+    result.append(str, tail, npos);
+    return matched ? Regex::Status::Match : Regex::Status::NoMatch;
+}
+
+Replacer& Replacer::if_contains(std::wstring&& literal) {
+    this->gate_if.emplace_back(std::move(literal));
+    return *this;
+}
+
+Replacer& Replacer::unless_contains(std::wstring&& literal) {
+    this->gate_unless.emplace_back(std::move(literal));
+    return *this;
+}
+
+Replacer& Replacer::stop(bool terminal) noexcept {
+    this->terminal = terminal;
+    return *this;
+}
+
+bool Replacer::is_applicable(std::wstring_view str) const noexcept {
+    for (const auto& literal : this->gate_unless) {
+        if (text::contains(str, literal)) return false;
+    }
+
+    if (this->gate_if.empty()) return true;
+
+    for (const auto& literal : this->gate_if) {
+        if (text::contains(str, literal)) return true;
+    }
+
+    return false;
+}
+
+bool Replacer::is_terminal() const noexcept {
+    return this->terminal;
+}
+
+Replacer& Replacer::budget(const Budget& budget) noexcept {
+    this->limit = budget;
+    return *this;
+}
+
+const Budget& Replacer::get_budget() const noexcept {
+    return this->limit;
+}
+
+const Regex& Replacer::regex() const noexcept {
+    return this->pattern;
+}
+
+uint64_t Replacer::exhausted_count() const noexcept {
+    return this->exhausted.get();
+}
+
+void Replacer::on_exhausted() const noexcept {
+    this->exhausted.bump();
 }
 
 Cleaner::Cleaner() {}
 Cleaner::Cleaner(std::vector<Replacer>&& replacers) : replacers(std::move(replacers)) {
 }
 
-Cleaner& Cleaner::emplace_back(std::wregex&& pattern, std::wstring&& replacement) {
+Cleaner& Cleaner::emplace_back(Regex&& pattern, std::wstring&& replacement) {
     this->replacers.emplace_back(std::move(pattern), std::move(replacement));
     return *this;
 }
 
-std::optional<std::wstring> Cleaner::clean(std::wstring str) const {
+Cleaner& Cleaner::push_back(Replacer&& replacer) {
+    this->replacers.push_back(std::move(replacer));
+    return *this;
+}
+
+Cleaner& Cleaner::budget(const Budget& budget) noexcept {
+    this->limit = budget;
+    return *this;
+}
+
+bool Cleaner::apply(std::wstring& str, std::wstring& buffer, const Cancellation* cancellation) const {
     const auto original_len = str.length();
+    const auto start = cancellation != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    Regex::Limits limits(this->limit);
+    if (cancellation != nullptr) limits.cancel_on(*cancellation);
 
     for (const auto& replacer : this->replacers) {
-        str = replacer.replace(str);
+        if (limits.is_cancelled()) {
+            this->on_cancelled(start);
+            return false;
+        }
+        if (!replacer.is_applicable(str)) continue;
+
+        Regex::Limits rule_limits(limits);
+        rule_limits.restrict(replacer.get_budget());
+
+        const auto status = replacer.apply(str, buffer, rule_limits);
+        limits.charge(rule_limits);
+
+        if (status == Regex::Status::Exhausted) {
+            if (rule_limits.is_cancelled()) {
+                this->on_cancelled(start);
+                return false;
+            }
+            replacer.on_exhausted();
+            if (limits.is_exhausted()) break;
+        }
+        else if (status == Regex::Status::Match && replacer.is_terminal()) {
+            break;
+        }
     }
 
-    if (original_len != str.length()) {
+    return original_len != str.length();
+}
+
+void Cleaner::on_cancelled(std::chrono::steady_clock::time_point start) const noexcept {
+    this->cancelled.bump();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    this->cancelled_time.add(static_cast<uint64_t>(elapsed.count()));
+}
+
+std::optional<std::wstring> Cleaner::clean(std::wstring str) const {
+    std::wstring buffer;
+
+    if (this->apply(str, buffer)) {
         return str;
     }
     else {
@@ -47,3 +450,117 @@ std::optional<std::wstring> Cleaner::clean(std::wstring str) const {
     }
 }
 
+std::optional<std::wstring> Cleaner::clean(std::wstring str, const Cancellation& cancellation) const {
+    std::wstring buffer;
+
+    if (this->apply(str, buffer, &cancellation)) {
+        return str;
+    }
+    else {
+        return std::nullopt;
+    }
+}
+
+std::optional<std::wstring> Cleaner::clean(std::wstring_view str, Incremental& state) const {
+    const auto result = this->clean_view(str, state, nullptr);
+    return result.has_value() ? std::optional<std::wstring>(*result) : std::nullopt;
+}
+
+std::optional<std::wstring> Cleaner::clean(std::wstring_view str, Incremental& state, const Cancellation& cancellation) const {
+    const auto result = this->clean_view(str, state, &cancellation);
+    return result.has_value() ? std::optional<std::wstring>(*result) : std::nullopt;
+}
+
+std::optional<std::wstring_view> Cleaner::clean_view(std::wstring_view str, Incremental& state, const Cancellation& cancellation) const {
+    return this->clean_view(str, state, &cancellation);
+}
+
+std::optional<std::wstring_view> Cleaner::clean_view(std::wstring_view str, Incremental& state, const Cancellation* cancellation) const {
+    const auto original_len = str.length();
+    const auto start = cancellation != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    Regex::Limits limits(this->limit);
+    if (cancellation != nullptr) limits.cancel_on(*cancellation);
+    state.steps.resize(this->replacers.size());
+
+    //Output of the last matched step, so that text is copied only as input of each step.
+    std::wstring_view current = str;
+    for (size_t idx = 0; idx < this->replacers.size(); idx++) {
+        const auto& replacer = this->replacers[idx];
+        auto& step = state.steps[idx];
+
+        //Steps, that are not reached, keep their previous text, so they are still valid.
+        if (limits.is_cancelled()) {
+            this->on_cancelled(start);
+            return std::nullopt;
+        }
+
+        if (!replacer.is_applicable(current)) {
+            step.valid = false;
+            continue;
+        }
+
+        //Text, that doesn't extend previous one, is replaced from scratch.
+        if (!step.valid || current.compare(0, step.input.size(), step.input) != 0) {
+            step.progress = Replacer::Progress();
+            step.output.clear();
+        }
+        step.input.assign(current);
+
+        Regex::Limits rule_limits(limits);
+        rule_limits.restrict(replacer.get_budget());
+
+        const auto status = replacer.apply(step.input, step.output, rule_limits, step.progress);
+        limits.charge(rule_limits);
+        step.valid = status != Regex::Status::Exhausted;
+
+        if (status == Regex::Status::Exhausted) {
+            if (rule_limits.is_cancelled()) {
+                this->on_cancelled(start);
+                return std::nullopt;
+            }
+            replacer.on_exhausted();
+            if (limits.is_exhausted()) break;
+        }
+        else if (status == Regex::Status::Match) {
+            current = step.output;
+            if (replacer.is_terminal()) break;
+        }
+    }
+
+    //Changed text is always output of some step, which is kept by state.
+    if (original_len != current.length()) {
+        return current;
+    }
+    else {
+        return std::nullopt;
+    }
+}
+
+std::vector<std::optional<std::wstring>> Cleaner::clean_batch(const std::vector<std::wstring>& texts, Pool& pool) const {
+    //Buffers of worker, reused for every text it cleans.
+    struct alignas(64) Scratch {
+        std::wstring text;
+        std::wstring buffer;
+    };
+
+    std::vector<std::optional<std::wstring>> result(texts.size());
+    std::vector<Scratch> scratch(pool.size());
+
+    pool.run(texts.size(), [this, &texts, &result, &scratch](unsigned worker, size_t idx) {
+        auto& own = scratch[worker];
+        own.text.assign(texts[idx]);
+        if (this->apply(own.text, own.buffer)) result[idx] = own.text;
+    });
+
+    return result;
+}
+
+Cleaner::Stats Cleaner::stats() const noexcept {
+    Stats result{0, this->cancelled.get(), std::chrono::nanoseconds(this->cancelled_time.get())};
+
+    for (const auto& replacer : this->replacers) {
+        result.exhausted += replacer.exhausted_count();
+    }
+
+    return result;
+}
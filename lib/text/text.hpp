@@ -1,19 +1,150 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <optional>
 #include <vector>
-#include <regex>
+#include <atomic>
+#include <cstdint>
+
+#include "regex.hpp"
+#include "pool.hpp"
 
 namespace text {
+    ///Looks up literal within text.
+    ///
+    ///Candidates are located by means of `wmemchr` which is vectorized by C runtime.
+    ///
+    ///@retval true If `needle` is found within `haystack` or `needle` is empty.
+    ///@retval false Otherwise.
+    bool contains(std::wstring_view haystack, std::wstring_view needle) noexcept;
+
+    ///Statistic counter which can be bumped from const methods.
+    class Counter {
+        private:
+            mutable std::atomic<uint64_t> value;
+
+        public:
+            Counter() noexcept : value(0) {}
+            Counter(const Counter& other) noexcept : value(other.get()) {}
+            Counter& operator=(const Counter& other) noexcept {
+                this->value.store(other.get(), std::memory_order_relaxed);
+                return *this;
+            }
+
+            void bump() const noexcept {
+                this->add(1);
+            }
+
+            void add(uint64_t amount) const noexcept {
+                this->value.fetch_add(amount, std::memory_order_relaxed);
+            }
+
+            uint64_t get() const noexcept {
+                return this->value.load(std::memory_order_relaxed);
+            }
+    };
+
     class Replacer {
         private:
-            std::wregex pattern;
-            std::wstring replacement;
+            ///Part of replacement text.
+            struct Piece {
+                enum class Kind {
+                    Literal,
+                    Group,
+                    ///Text before match.
+                    Prefix,
+                    ///Text after match.
+                    Suffix,
+                };
+
+                Kind kind;
+                std::wstring literal;
+                unsigned group;
+            };
+
+            Regex pattern;
+            std::vector<Piece> replacement;
+            ///Rule is applied only if any of these literals is present.
+            std::vector<std::wstring> gate_if;
+            ///Rule is skipped if any of these literals is present.
+            std::vector<std::wstring> gate_unless;
+            ///Whether to stop chain when rule matches.
+            bool terminal;
+            ///Whether replacement contains text after match, so it changes whenever text grows.
+            bool has_suffix;
+            Budget limit;
+            Counter exhausted;
+
+            ///Appends text since `tail` and replacement of match.
+            void substitute(std::wstring& result, const std::wstring& str, const Regex::Captures& captures, size_t tail) const;
+
         public:
-            Replacer(std::wregex&& pattern, std::wstring&& replacement);
+            /**
+             * Part of text, which has been replaced for good.
+             *
+             * Matches, which didn't depend on end of text, stay the same once text is extended,
+             * so replacement of extended text can start from there.
+             */
+            struct Progress {
+                ///End of last stable match.
+                size_t tail = 0;
+                ///Position to resume search from.
+                size_t pos = 0;
+                ///Length of result up to `tail`.
+                size_t output = 0;
+                ///Whether search at `pos` has to skip empty match.
+                bool not_empty = false;
+                ///Whether there is match before `tail`.
+                bool matched = false;
+            };
+
+            Replacer(Regex&& pattern, std::wstring&& replacement);
             ///Replaces text according to pattern and provided replacement text.
             std::wstring replace(const std::wstring&) const;
+            ///Replaces text in place within limits.
+            ///
+            ///@retval Match If pattern matched at least once.
+            ///@retval NoMatch Otherwise.
+            ///@retval Exhausted If limits are exceeded. Text is left unchanged.
+            Regex::Status apply(std::wstring& text, Regex::Limits& limits) const;
+            ///Same as above, but builds result in `buffer` and swaps it with text.
+            ///
+            ///Reusing buffer between calls avoids allocations.
+            Regex::Status apply(std::wstring& text, std::wstring& buffer, Regex::Limits& limits) const;
+            ///Replaces text, that extends text of previous call, into `result`.
+            ///
+            ///`result` must hold result of previous call, which is reused up to `progress`.
+            ///Start with default Progress and empty `result` for new text.
+            ///
+            ///@retval Exhausted If limits are exceeded. `result` and `progress` are no longer valid.
+            Regex::Status apply(const std::wstring& text, std::wstring& result, Regex::Limits& limits, Progress& progress) const;
+
+            ///Requires literal to be present in text for rule to apply.
+            ///
+            ///Multiple literals are combined with OR.
+            Replacer& if_contains(std::wstring&& literal);
+            ///Skips rule when literal is present in text.
+            ///
+            ///Multiple literals are combined with OR.
+            Replacer& unless_contains(std::wstring&& literal);
+            ///Stops Cleaner's chain after this rule matches.
+            Replacer& stop(bool terminal) noexcept;
+            ///Sets limits of single rule application.
+            Replacer& budget(const Budget& budget) noexcept;
+
+            ///@return Whether gates allow rule to be applied onto text.
+            bool is_applicable(std::wstring_view text) const noexcept;
+            ///@return Whether rule stops chain on match.
+            bool is_terminal() const noexcept;
+            ///@return Limits of single rule application.
+            const Budget& get_budget() const noexcept;
+            ///@return Pattern of rule.
+            const Regex& regex() const noexcept;
+            ///@return Number of times rule has been skipped due to exceeded budget.
+            uint64_t exhausted_count() const noexcept;
+            ///Accounts skip due to exceeded budget.
+            void on_exhausted() const noexcept;
     };
 
     /**
@@ -22,14 +153,90 @@ namespace text {
     class Cleaner {
         private:
             std::vector<Replacer> replacers;
+            Budget limit;
+            Counter cancelled;
+            ///Time of cancelled cleans until they are aborted, in nanoseconds.
+            Counter cancelled_time;
+
+            ///Cleans text in place, using buffer for intermediate results.
+            ///
+            ///@return Whether text is changed.
+            bool apply(std::wstring& text, std::wstring& buffer, const Cancellation* cancellation = nullptr) const;
+            ///Accounts clean, that is aborted by cancellation.
+            void on_cancelled(std::chrono::steady_clock::time_point start) const noexcept;
+
+        public:
+            struct Stats {
+                ///Number of rule applications skipped due to exceeded budget.
+                uint64_t exhausted;
+                ///Number of cleans aborted by cancellation.
+                uint64_t cancelled;
+                ///Time, that cancelled cleans took until they were aborted.
+                std::chrono::nanoseconds cancelled_time;
+            };
+
+            /**
+             * State of cleaning text, that keeps growing.
+             *
+             * Hooks often deliver the same line over and over as it grows. Each rule remembers
+             * its last input and how much of it has been replaced for good, so that extended
+             * text is searched only past that point.
+             */
+            class Incremental {
+                friend class Cleaner;
+
+                private:
+                    struct Step {
+                        std::wstring input;
+                        std::wstring output;
+                        Replacer::Progress progress;
+                        bool valid = false;
+                    };
+
+                    std::vector<Step> steps;
+            };
+
+        private:
+            std::optional<std::wstring_view> clean_view(std::wstring_view text, Incremental& state, const Cancellation* cancellation) const;
 
         public:
             Cleaner();
             explicit Cleaner(std::vector<Replacer>&& replacers);
-            Cleaner& emplace_back(std::wregex&& pattern, std::wstring&& replacement);
+            Cleaner& emplace_back(Regex&& pattern, std::wstring&& replacement);
+            Cleaner& push_back(Replacer&& replacer);
+            ///Sets limits of whole clean, shared by all rules.
+            Cleaner& budget(const Budget& budget) noexcept;
             ///Cleans text.
+            ///
+            ///Rules are applied in order, skipping ones which gates do not allow.
+            ///Chain stops after first matched terminal rule.
+            ///
+            ///Rule which exceeds its budget is skipped.
+            ///Once budget of whole clean is exceeded, remaining rules are skipped.
             std::optional<std::wstring> clean(std::wstring) const;
+            ///Cleans text, reusing work done on previous text if new one extends it.
+            ///
+            ///Text is only read, so it can be viewed in place, e.g. on clipboard.
+            ///Result is the same as of `clean(text)`.
+            std::optional<std::wstring> clean(std::wstring_view text, Incremental& state) const;
+            ///Cleans text, unless it is cancelled meanwhile.
+            ///
+            ///@return None as well, if cancelled, which is told by token.
+            std::optional<std::wstring> clean(std::wstring text, const Cancellation& cancellation) const;
+            ///Same as above, reusing work done on previous text.
+            std::optional<std::wstring> clean(std::wstring_view text, Incremental& state, const Cancellation& cancellation) const;
+            ///Same as above, without copying result out of state.
+            ///
+            ///@return View of result, which is valid until next clean with the same state.
+            std::optional<std::wstring_view> clean_view(std::wstring_view text, Incremental& state, const Cancellation& cancellation) const;
+            ///Cleans texts in parallel on pool.
+            ///
+            ///@return Result of `clean` for each text, in the same order.
+            std::vector<std::optional<std::wstring>> clean_batch(const std::vector<std::wstring>& texts, Pool& pool) const;
+            ///@return Statistics of all cleans so far.
+            Stats stats() const noexcept;
     };
 
-    std::wstring to_wide_string(const std::string& str);
+    std::wstring to_wide_string(std::string_view str);
+    std::string to_utf8_string(std::wstring_view str);
 }
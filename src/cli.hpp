@@ -1,7 +1,7 @@
 #include <string>
 #include <sstream>
 #include <filesystem>
-namespace fs = std::experimental::filesystem;
+namespace fs = std::filesystem;
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -14,6 +14,40 @@ namespace cli {
     struct Args {
     public:
         std::string config;
+        ///Whether to only check rules' complexity.
+        bool check = false;
+        ///Named pipe to take clipboard changes from, instead of system clipboard.
+        std::string fifo;
+        ///Time to wait for clipboard to settle before cleaning, in milliseconds.
+        unsigned debounce = 0;
+        ///Length of clipboard text, above which it is large, 0 if there is no limit.
+        size_t large = 65536;
+        ///Handling of large clipboard text: `skip` or `chunk`.
+        std::string large_mode = "skip";
+        ///File to clean instead of clipboard.
+        std::string input;
+        ///File to write cleaned input, stdout if empty.
+        std::string output;
+        ///Number of cleaning threads, 0 means number of cores.
+        unsigned jobs = 0;
+        ///Whether to clean stdin into stdout.
+        bool filter = false;
+        ///Output buffering of filter: `line`, `block` or empty to choose by input.
+        std::string buffer;
+        ///Log file to follow, cleaning lines appended to it.
+        std::string follow;
+        ///Name of shared-memory ring to create and clean lines from.
+        std::string ring;
+        ///Whether lines of follow and ring are tagged by stream, which selects profile of rules.
+        bool streams = false;
+        ///Unix domain socket to serve cleaning on.
+        std::string serve;
+        ///Port on localhost to serve cleaning on, 0 if none.
+        unsigned port = 0;
+        ///Unix domain socket to publish cleaned lines on.
+        std::string publish;
+        ///Port on localhost to publish cleaned lines on over WebSocket, 0 if none.
+        unsigned publish_port = 0;
     };
 
     class Parser {
@@ -76,6 +110,23 @@ namespace cli {
             po::options_description desc(description.c_str());
 
             desc.add_options()("config,c", po::value<std::string>(&result.config)->multitoken(), "Specifies configuration file to use.");
+            desc.add_options()("check", po::bool_switch(&result.check), "Checks rules for slow patterns and exits.");
+            desc.add_options()("fifo", po::value<std::string>(&result.fifo), "Takes copied text as lines of named pipe instead of clipboard, writing cleaned text into stdout.");
+            desc.add_options()("debounce", po::value<unsigned>(&result.debounce), "Cleans clipboard once it does not change for given milliseconds. By default at once.");
+            desc.add_options()("large", po::value<size_t>(&result.large), "Treats clipboard text longer than given number of characters as large. 0 means no limit. By default 65536.");
+            desc.add_options()("large-mode", po::value<std::string>(&result.large_mode), "Specifies handling of large clipboard text: skip or chunk, which cleans it line by line in background. By default skip.");
+            desc.add_options()("input,i", po::value<std::string>(&result.input), "Cleans file line by line instead of clipboard.");
+            desc.add_options()("output,o", po::value<std::string>(&result.output), "Specifies file to write cleaned input. By default stdout.");
+            desc.add_options()("jobs,j", po::value<unsigned>(&result.jobs), "Specifies number of cleaning threads. By default number of cores.");
+            desc.add_options()("filter,f", po::bool_switch(&result.filter), "Cleans stdin line by line into stdout.");
+            desc.add_options()("buffer", po::value<std::string>(&result.buffer), "Specifies output buffering of filter: line or block. By default line for terminal.");
+            desc.add_options()("follow", po::value<std::string>(&result.follow), "Follows file, cleaning lines as they are appended to it.");
+            desc.add_options()("ring", po::value<std::string>(&result.ring), "Creates shared-memory ring with given name and cleans lines, that hook writes into it.");
+            desc.add_options()("streams", po::bool_switch(&result.streams), "Cleans lines of follow or ring, that start with stream name and tab, by profile of stream.");
+            desc.add_options()("serve", po::value<std::string>(&result.serve), "Serves cleaning on Unix domain socket.");
+            desc.add_options()("port", po::value<unsigned>(&result.port), "Serves cleaning on port of localhost.");
+            desc.add_options()("publish", po::value<std::string>(&result.publish), "Publishes cleaned lines to subscribers of Unix domain socket.");
+            desc.add_options()("publish-port", po::value<unsigned>(&result.publish_port), "Publishes cleaned lines to WebSocket subscribers on port of localhost.");
             desc.add_options()("help,h", "Prints help information.");
             if (d_version) {
                 desc.add_options()("version", "Prints version information.");
@@ -97,6 +148,26 @@ namespace cli {
                 exit(1);
             }
 
+            if (!result.buffer.empty() && result.buffer != "line" && result.buffer != "block") {
+                std::cerr << "buffer should be either line or block\n";
+                exit(1);
+            }
+
+            if (result.large_mode != "skip" && result.large_mode != "chunk") {
+                std::cerr << "large-mode should be either skip or chunk\n";
+                exit(1);
+            }
+
+            if (result.port > 65535) {
+                std::cerr << "port should be within 1-65535\n";
+                exit(1);
+            }
+
+            if (result.publish_port > 65535) {
+                std::cerr << "publish-port should be within 1-65535\n";
+                exit(1);
+            }
+
             if (vm.count("help")) {
                 std::cout << desc << "\n";
                 exit(0);
@@ -1,37 +1,72 @@
 #include <fstream>
+#include <optional>
 
+#if (_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable: 4996)
+#endif
 #include <toml/toml.h>
+#if (_MSC_VER)
 #pragma warning(pop)
+#endif
 
 #include <text/text.hpp>
 #include "config.hpp"
 
-#include <windows.h>
-
 using namespace config;
 
-std::variant<Config, std::string> config::open(const char* file) {
-    std::ifstream file_stream(file);
+///Reads literal gate which is either single string or array of strings.
+static std::optional<std::vector<std::wstring>> read_literals(const toml::Value& value) {
+    std::vector<std::wstring> result;
 
-    if (file_stream.fail()) {
-        return std::string("Cannot open config file: ") + file;
+    if (value.is<std::string>()) {
+        result.push_back(text::to_wide_string(value.as<std::string>()));
+    }
+    else if (value.is<toml::Array>()) {
+        for (const toml::Value& literal : value.as<toml::Array>()) {
+            if (!literal.is<std::string>()) return std::nullopt;
+            result.push_back(text::to_wide_string(literal.as<std::string>()));
+        }
+    }
+    else {
+        return std::nullopt;
     }
 
-    const auto pr = toml::parse(file_stream);
+    return result;
+}
 
-    if (!pr.valid()) {
-        return pr.errorReason;
+///Reads matcher limits.
+///
+///@returns Error description on failure.
+static std::optional<std::string> read_budget(const toml::Table& table, text::Budget& budget) {
+    if (const auto steps = table.find("max_steps"); steps != table.end()) {
+        if (!steps->second.is<int64_t>() || steps->second.as<int64_t>() < 0) return std::string("max_steps key is not a positive integer!");
+        budget.steps = static_cast<uint64_t>(steps->second.as<int64_t>());
     }
 
-    Config result;
+    if (const auto time = table.find("max_time_us"); time != table.end()) {
+        if (!time->second.is<int64_t>() || time->second.as<int64_t>() < 0) return std::string("max_time_us key is not a positive integer!");
+        budget.time = std::chrono::microseconds(time->second.as<int64_t>());
+    }
 
-    if (const auto replace = pr.value.find("replace")) {
+    return std::nullopt;
+}
+
+///Reads rules of profile from table.
+///
+///@returns Error description on failure.
+static std::optional<std::string> read_profile(const toml::Value& root, Profile& result) {
+    if (const auto budget = root.findChild("budget")) {
+        if (!budget->is<toml::Table>()) return std::string("budget is not a table!");
+        if (auto error = read_budget(budget->as<toml::Table>(), result.budget)) return *error;
+    }
+
+    if (const auto replace = root.findChild("replace")) {
         if (replace->is<toml::Array>()) {
             for (const toml::Value& value : replace->as<toml::Array>()) {
                 if (value.is<toml::Table>()) {
                     const auto table = value.as<toml::Table>();
+                    text::Budget budget;
 
                     const auto pattern = table.find("pattern");
                     if (pattern == table.end()) return std::string("Missing pattern key!");
@@ -43,7 +78,38 @@ std::variant<Config, std::string> config::open(const char* file) {
                     if (!replacement->second.is<std::string>()) return std::string("replacement key is not a string!");
                     auto replacement_value = text::to_wide_string(replacement->second.as<std::string>());
 
-                    result.replace.emplace_back(std::wregex(pattern_value), std::move(replacement_value));
+                    std::optional<text::Regex> regex;
+                    try {
+                        regex.emplace(pattern_value);
+                    }
+                    catch (const std::runtime_error& error) {
+                        return std::string("Invalid pattern '") + pattern->second.as<std::string>() + "': " + error.what();
+                    }
+
+                    text::Replacer replacer(std::move(*regex), std::move(replacement_value));
+
+                    if (auto error = read_budget(table, budget)) return *error;
+                    replacer.budget(budget);
+
+                    if (const auto stop = table.find("stop"); stop != table.end()) {
+                        if (!stop->second.is<bool>()) return std::string("stop key is not a boolean!");
+                        replacer.stop(stop->second.as<bool>());
+                    }
+
+                    if (const auto gate = table.find("if_contains"); gate != table.end()) {
+                        auto literals = read_literals(gate->second);
+                        if (!literals.has_value()) return std::string("if_contains key is not a string or array of strings!");
+                        for (auto& literal : *literals) replacer.if_contains(std::move(literal));
+                    }
+
+                    if (const auto gate = table.find("unless_contains"); gate != table.end()) {
+                        auto literals = read_literals(gate->second);
+                        if (!literals.has_value()) return std::string("unless_contains key is not a string or array of strings!");
+                        for (auto& literal : *literals) replacer.unless_contains(std::move(literal));
+                    }
+
+                    result.analysis.push_back(text::analyze(replacer.regex()));
+                    result.replace.push_back(std::move(replacer));
                 }
                 else {
                     return std::string("Unexpected replace pattern!");
@@ -52,5 +118,33 @@ std::variant<Config, std::string> config::open(const char* file) {
         }
     }
 
+    return std::nullopt;
+}
+
+std::variant<Config, std::string> config::open(const char* file) {
+    std::ifstream file_stream(file);
+
+    if (file_stream.fail()) {
+        return std::string("Cannot open config file: ") + file;
+    }
+
+    const auto pr = toml::parse(file_stream);
+
+    if (!pr.valid()) {
+        return pr.errorReason;
+    }
+
+    Config result;
+    if (auto error = read_profile(pr.value, result)) return *error;
+
+    //Named streams can have rules of their own.
+    if (const auto profiles = pr.value.findChild("profile")) {
+        if (!profiles->is<toml::Table>()) return std::string("profile is not a table!");
+        for (const auto& entry : profiles->as<toml::Table>()) {
+            if (!entry.second.is<toml::Table>()) return std::string("profile.") + entry.first + " is not a table!";
+            if (auto error = read_profile(entry.second, result.profiles[entry.first])) return "profile." + entry.first + ": " + *error;
+        }
+    }
+
     return result;
 }
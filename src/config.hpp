@@ -1,13 +1,25 @@
 #pragma once
 
+#include <map>
 #include <variant>
 #include <string>
 
 #include <text/text.hpp>
+#include <text/analysis.hpp>
 
 namespace config {
-    struct Config {
+    ///Rules of single stream.
+    struct Profile {
         std::vector<text::Replacer> replace;
+        ///Backtracking complexity of each rule in `replace`.
+        std::vector<text::Analysis> analysis;
+        ///Limits of whole clean.
+        text::Budget budget;
+    };
+
+    ///Default rules together with profiles of named streams.
+    struct Config : Profile {
+        std::map<std::string, Profile> profiles;
     };
 
     /**
@@ -10,16 +10,25 @@ EXPORT unsigned int __stdcall TAPluginGetVersion(const void *) {
 	return TA_PLUGIN_VERSION;
 }
 
-static text::Cleaner cleaner(std::vector<text::Replacer>{
-        text::Replacer(std::wregex(L"<[^>]+>"), L""),
-        text::Replacer(std::wregex(L".*(.+)\\1+"), L"$1")
+static text::Cleaner init_cleaner() {
+    text::Cleaner result(std::vector<text::Replacer>{
+        text::Replacer(text::Regex(L"<[^>]+>"), L""),
+        text::Replacer(text::Regex(L".*(.+)\\1+"), L"$1")
         });
+    //Translation Aggregator waits for us, so never let pathological text to hang it.
+    result.budget(text::Budget{0, std::chrono::milliseconds(50)});
+    return result;
+}
+
+static text::Cleaner cleaner = init_cleaner();
+//Hook delivers the same line over and over as it grows.
+static text::Cleaner::Incremental state;
 
 std::wstring buffer;
 
 // Can return null if does nothing to string.
 EXPORT wchar_t * __stdcall TAPluginModifyStringPreSubstitution(wchar_t *in) {
-    auto result = cleaner.clean(std::wstring(in));
+    auto result = cleaner.clean(std::wstring_view(in), state);
 
     if (result.has_value()) {
         buffer.swap(*result);
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+#include <boost/program_options/parsers.hpp>
+
+#include <service/client.hpp>
+#include <service/protocol.hpp>
+
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock Clock;
+
+///Connection, that keeps single request in flight, sending the next one as soon as response comes.
+struct Connection {
+    int handle;
+    std::string input;
+    Clock::time_point sent_at;
+    size_t remaining;
+};
+
+///Thousands of connections need more descriptors than default soft limit.
+static void raise_descriptor_limit() {
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static void send_request(Connection& connection, const std::string& message) {
+    connection.sent_at = Clock::now();
+    //Request is small enough to fit into socket buffer at once.
+    if (write(connection.handle, message.data(), message.size()) != static_cast<ssize_t>(message.size())) {
+        throw std::runtime_error(std::string("Failed to send request: ") + std::strerror(errno));
+    }
+    connection.remaining -= 1;
+}
+
+static double percentile(const std::vector<double>& sorted, double rank) {
+    const auto idx = static_cast<size_t>(rank * static_cast<double>(sorted.size() - 1));
+    return sorted[idx];
+}
+
+int main(int argc, char* argv[]) {
+    std::string socket_path;
+    unsigned port = 0;
+    size_t connection_count = 100;
+    size_t requests = 1000;
+    std::string text = "<color=#ffffff24>「御館様」</color>";
+
+    po::options_description desc("Load generator of vn-text-trim cleaning service.\n\nUSAGE:\n    vn-text-trim-loadgen [OPTIONS]\n\nOPTIONS");
+    desc.add_options()("socket,s", po::value<std::string>(&socket_path), "Unix domain socket of service.");
+    desc.add_options()("port,p", po::value<unsigned>(&port), "Port of service on localhost.");
+    desc.add_options()("connections,c", po::value<size_t>(&connection_count), "Number of concurrent connections. By default 100.");
+    desc.add_options()("requests,n", po::value<size_t>(&requests), "Number of requests per connection. By default 1000.");
+    desc.add_options()("text,t", po::value<std::string>(&text), "Text of request.");
+    desc.add_options()("help,h", "Prints help information.");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    }
+    catch (po::error& err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+    if (vm.count("help") || (socket_path.empty() && port == 0) || connection_count == 0 || requests == 0) {
+        std::cout << desc << "\n";
+        return vm.count("help") ? 0 : 1;
+    }
+
+    raise_descriptor_limit();
+
+    std::string message;
+    service::encode(text, message);
+
+    std::vector<Connection> connections(connection_count);
+    std::vector<double> latencies;
+    latencies.reserve(connection_count * requests);
+
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    try {
+        for (size_t idx = 0; idx < connections.size(); idx++) {
+            auto& connection = connections[idx];
+            connection.handle = socket_path.empty() ? service::connect_tcp(static_cast<uint16_t>(port)) : service::connect_unix(socket_path);
+            connection.remaining = requests;
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u64 = idx;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, connection.handle, &event);
+        }
+
+        const auto start = Clock::now();
+        for (auto& connection : connections) {
+            send_request(connection, message);
+        }
+
+        size_t active = connections.size();
+        epoll_event events[256];
+        char buffer[64 * 1024];
+        while (active > 0) {
+            const int count = epoll_wait(epoll, events, 256, -1);
+            if (count == -1) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error(std::string("Failed to wait for responses: ") + std::strerror(errno));
+            }
+
+            for (int idx = 0; idx < count; idx++) {
+                auto& connection = connections[events[idx].data.u64];
+                const ssize_t size = read(connection.handle, buffer, sizeof(buffer));
+                if (size <= 0) throw std::runtime_error("Connection is closed by service");
+                connection.input.append(buffer, static_cast<size_t>(size));
+
+                std::string_view response;
+                const size_t consumed = service::decode(connection.input, response);
+                if (consumed == 0) continue;
+                latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - connection.sent_at).count());
+                connection.input.erase(0, consumed);
+
+                if (connection.remaining > 0) send_request(connection, message);
+                else active -= 1;
+            }
+        }
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "Requests: " << latencies.size() << " over " << connections.size() << " connections in " << elapsed << "s (" << static_cast<double>(latencies.size()) / elapsed << " req/s)\n"
+                  << "Latency: p50 " << percentile(latencies, 0.5) << "us, p90 " << percentile(latencies, 0.9) << "us, p99 " << percentile(latencies, 0.99)
+                  << "us, p99.9 " << percentile(latencies, 0.999) << "us, max " << latencies.back() << "us\n";
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+
+    for (const auto& connection : connections) {
+        if (connection.handle > 0) close(connection.handle);
+    }
+    close(epoll);
+    return 0;
+}
@@ -1,13 +1,531 @@
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <clocale>
+#include <csignal>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-#include <clipboard/clipboard.hpp>
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+#include <clipboard/backend.hpp>
+#include <clipboard/chunked.hpp>
+#include <clipboard/latency.hpp>
+#include <clipboard/repeats.hpp>
+#include <clipboard/scheduler.hpp>
+#include <clipboard/writer.hpp>
+#include <corpus/corpus.hpp>
+#include <corpus/file.hpp>
+#include <corpus/streams.hpp>
+
+#ifdef __linux__
+#include <sys/resource.h>
+
+#include <service/broadcast.hpp>
+#include <service/server.hpp>
+#endif
 
 #include "cli.hpp"
 #include "config.hpp"
 
-static inline text::Cleaner init_cleaner(config::Config&& config) {
-    return text::Cleaner(std::move(config.replace));
+static inline text::Cleaner init_cleaner(config::Profile&& config) {
+    text::Cleaner result(std::move(config.replace));
+    result.budget(config.budget);
+    return result;
+}
+
+///Cleaners of named streams.
+typedef std::map<std::string, text::Cleaner> Profiles;
+
+///Describes complexity of rule.
+static inline void print_analysis(std::ostream& out, size_t idx, const text::Replacer& rule, const text::Analysis& analysis) {
+    out << "Rule #" << idx + 1 << " '" << text::to_utf8_string(rule.regex().source()) << "': " << text::to_string(analysis.complexity);
+    if (analysis.complexity == text::Analysis::Complexity::Polynomial) {
+        out << " (degree " << analysis.degree << ")";
+    }
+    out << " - " << analysis.reason << "\n";
+}
+
+///Prints complexity of each rule together with its time on adversarial text.
+///
+///@returns Exit code, which is non-zero if there is exponential rule.
+static inline int check_rules(const config::Profile& config) {
+    //Rule which is slower than that on short text cannot be used.
+    static constexpr std::chrono::microseconds MEASURE_LIMIT(100000);
+
+    int result = 0;
+    for (size_t idx = 0; idx < config.replace.size(); idx++) {
+        const auto& rule = config.replace[idx];
+        const auto& analysis = config.analysis[idx];
+
+        print_analysis(std::cout, idx, rule, analysis);
+        if (!analysis.pump.empty()) {
+            std::cout << "    adversarial text: '" << text::to_utf8_string(analysis.prefix) << "' + '" << text::to_utf8_string(analysis.pump.substr(0, 16)) << "'...\n";
+        }
+        for (const auto& sample : text::measure(rule, analysis, MEASURE_LIMIT)) {
+            std::cout << "    " << sample.length << " characters: " << sample.time.count() << "us";
+            if (sample.exhausted) std::cout << " (time limit)";
+            std::cout << "\n";
+        }
+
+        if (analysis.complexity == text::Analysis::Complexity::Exponential) result = 1;
+    }
+
+    return result;
+}
+
+///Warns about rules, that can take exponential time.
+static inline void warn_rules(const config::Profile& config) {
+    for (size_t idx = 0; idx < config.replace.size(); idx++) {
+        if (config.analysis[idx].complexity == text::Analysis::Complexity::Exponential) {
+            std::cerr << "Warning: ";
+            print_analysis(std::cerr, idx, config.replace[idx], config.analysis[idx]);
+        }
+    }
+}
+
+///Hands cleaned line over to subscribers.
+///
+///Empty when nothing is published.
+using Publish = std::function<void(std::string_view)>;
+
+///Publishes each line of cleaned output.
+static inline void publish_lines(const Publish& publish, std::string_view data) {
+    if (!publish) return;
+
+    while (!data.empty()) {
+        const auto end = data.find('\n');
+        auto line = data.substr(0, end);
+        //Line end of CRLF output is not part of line.
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        publish(line);
+        if (end == std::string_view::npos) break;
+        data.remove_prefix(end + 1);
+    }
+}
+
+///Cleans input file into output one.
+///
+///@returns Exit code.
+static inline int clean_file(const cli::Args& args, const text::Cleaner& cleaner) {
+    try {
+        //Output is truncated, while input is still read from it.
+        if (corpus::is_same_file(args.input, args.output)) throw std::runtime_error("Output is the same file as input: " + args.output);
+
+        //Input is mapped, so that lines are cleaned straight from file without copying.
+        const corpus::MappedFile input(args.input);
+        corpus::OutputFile output(args.output);
+
+        const auto stats = corpus::process(input.view(), [&output](std::string_view data) {
+            output.write(data);
+        }, cleaner, args.jobs);
+        output.flush();
+
+        if (!output.is_ok()) {
+            std::cerr << "Failed to write output\n";
+            return 1;
+        }
+
+        std::cerr << "Cleaned " << stats.lines << " lines, " << stats.bytes_read << " bytes into " << stats.bytes_written << " bytes in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(stats.elapsed).count() << "ms (" << stats.throughput() << " MiB/s)\n";
+        return 0;
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+}
+
+///Cleans stdin into stdout.
+///
+///@returns Exit code.
+static inline int clean_filter(const cli::Args& args, const text::Cleaner& cleaner) {
+    try {
+        corpus::InputFile input("");
+        corpus::OutputFile output("");
+
+        auto buffering = input.is_interactive() ? corpus::Buffering::Line : corpus::Buffering::Block;
+        if (args.buffer == "line") buffering = corpus::Buffering::Line;
+        else if (args.buffer == "block") buffering = corpus::Buffering::Block;
+
+        corpus::filter(input, output, cleaner, buffering, args.jobs);
+
+        if (!output.is_ok()) {
+            std::cerr << "Failed to write output\n";
+            return 1;
+        }
+        return 0;
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+}
+
+///Feeds lines to streams.
+typedef std::function<void(corpus::Streams&)> Feed;
+
+/**
+ * Cleans lines tagged by stream, like `names<TAB>【茜】`, each stream by its own profile.
+ *
+ * Line without tag belongs to anonymous stream. Cleaned line is written with its tag.
+ */
+static inline void clean_streams(const cli::Args& args, const text::Cleaner& cleaner, const Profiles& profiles, corpus::OutputFile& output, const Publish& publish, const Feed& feed) {
+    std::mutex lock;
+    std::string tagged;
+    corpus::Streams streams(cleaner, [&lock, &tagged, &output, &publish](std::string_view stream, std::string_view line) {
+        //Workers of different streams finish lines at once.
+        const std::lock_guard<std::mutex> guard(lock);
+        tagged.clear();
+        if (!stream.empty()) tagged.append(stream).push_back('\t');
+        tagged.append(line);
+        if (publish) {
+            //Line end of CRLF output is not part of line.
+            std::string_view published(tagged);
+            if (!published.empty() && published.back() == '\r') published.remove_suffix(1);
+            publish(published);
+        }
+
+        tagged.push_back('\n');
+        output.write(tagged);
+        output.flush();
+    }, args.jobs);
+
+    for (const auto& profile : profiles) {
+        streams.profile(profile.first, profile.second);
+    }
+
+    feed(streams);
+    streams.finish();
+}
+
+///Splits tagged line and queues it into its stream.
+static inline void submit_tagged(corpus::Streams& streams, std::string_view line) {
+    const auto tab = line.find('\t');
+    if (tab == std::string_view::npos) streams.submit(std::string_view(), line);
+    else streams.submit(line.substr(0, tab), line.substr(tab + 1));
+}
+
+///Cleans lines appended to log file into output, until killed.
+///
+///@returns Exit code.
+static inline int clean_follow(const cli::Args& args, const text::Cleaner& cleaner, const Profiles& profiles, const Publish& publish) {
+    try {
+        //Output would be followed as input, growing endlessly.
+        if (corpus::is_same_file(args.follow, args.output)) throw std::runtime_error("Output is the same file as input: " + args.output);
+
+        corpus::Follower input(args.follow);
+        corpus::OutputFile output(args.output);
+
+        if (args.streams) {
+            clean_streams(args, cleaner, profiles, output, publish, [&input](corpus::Streams& streams) {
+                std::string lines;
+                while (input.next(lines)) {
+                    std::string_view rest(lines);
+                    for (size_t end = rest.find('\n'); end != std::string_view::npos; end = rest.find('\n')) {
+                        submit_tagged(streams, rest.substr(0, end));
+                        rest.remove_prefix(end + 1);
+                    }
+                }
+            });
+            return output.is_ok() ? 0 : 1;
+        }
+
+        //Each line is wanted as soon as it is hooked.
+        corpus::follow(input, [&output, &publish](std::string_view data) {
+            output.write(data);
+            output.flush();
+            publish_lines(publish, data);
+        }, cleaner);
+
+        return output.is_ok() ? 0 : 1;
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+}
+
+///Cleans lines from shared-memory ring into output, until hook closes it.
+///
+///@returns Exit code.
+static inline int clean_ring(const cli::Args& args, const text::Cleaner& cleaner, const Profiles& profiles, const Publish& publish) {
+    try {
+        corpus::RingConsumer input(args.ring);
+        corpus::OutputFile output(args.output);
+
+        if (args.streams) {
+            clean_streams(args, cleaner, profiles, output, publish, [&input](corpus::Streams& streams) {
+                std::string_view line;
+                while (input.next(line)) {
+                    submit_tagged(streams, line);
+                }
+            });
+            return output.is_ok() ? 0 : 1;
+        }
+
+        corpus::consume(input, [&output, &publish](std::string_view data) {
+            output.write(data);
+            output.flush();
+            publish_lines(publish, data);
+        }, cleaner);
+
+        return output.is_ok() ? 0 : 1;
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+}
+
+#ifdef __linux__
+///Serves cleaning on local socket, until interrupted.
+///
+///@returns Exit code.
+static inline int clean_serve(const cli::Args& args, const text::Cleaner& cleaner) {
+    //Signals are waited by dedicated thread, so that server stops cleanly, removing its socket.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    //Each client takes descriptor.
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    try {
+        service::Options options;
+        options.socket_path = args.serve;
+        if (args.port != 0) options.tcp_port = static_cast<uint16_t>(args.port);
+        options.workers = args.jobs;
+
+        service::Server server(cleaner, options);
+        std::thread([&server, signals]() {
+            int signal = 0;
+            sigwait(&signals, &signal);
+            server.stop();
+        }).detach();
+
+        std::cerr << "Serving";
+        if (!args.serve.empty()) std::cerr << " on " << args.serve;
+        if (server.port().has_value()) std::cerr << " on port " << *server.port();
+        std::cerr << "...\n";
+
+        server.run();
+        return 0;
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+}
+#endif
+
+//Signals of clipboard loop: SIGUSR1, or Ctrl+Break on Windows, dumps latency, while SIGINT and SIGTERM stop loop.
+#ifdef _WIN32
+static std::atomic<clipboard::Backend*> signal_backend(nullptr);
+static std::atomic<const clipboard::Latency*> signal_latency(nullptr);
+
+static void on_clipboard_signal(int signal) {
+    //Handler is called by own thread on Windows, so it acts at once, but it is reset after each call.
+    std::signal(signal, on_clipboard_signal);
+    if (signal == SIGBREAK) {
+        if (const auto latency = signal_latency.load()) latency->dump(std::cerr);
+    }
+    else if (const auto backend = signal_backend.load()) {
+        backend->stop();
+    }
+}
+#else
+//Handler only passes signal into pipe, as nothing else is safe within it.
+static int signal_pipe[2] = {-1, -1};
+
+static void on_clipboard_signal(int signal) {
+    const char value = static_cast<char>(signal);
+    [[maybe_unused]] const auto result = write(signal_pipe[1], &value, sizeof(value));
+}
+#endif
+
+///Handles signals of clipboard loop, until destroyed.
+class ClipboardSignals {
+    private:
+#ifndef _WIN32
+        std::thread thread;
+#endif
+
+    public:
+        ClipboardSignals(clipboard::Backend& backend, const clipboard::Latency& latency) {
+#ifdef _WIN32
+            signal_backend.store(&backend);
+            signal_latency.store(&latency);
+            std::signal(SIGBREAK, on_clipboard_signal);
+#else
+            if (pipe(signal_pipe) != 0) return;
+
+            this->thread = std::thread([&backend, &latency]() {
+                char value = 0;
+                for (ssize_t count; (count = read(signal_pipe[0], &value, sizeof(value))) != 0;) {
+                    if (count == -1) {
+                        if (errno == EINTR) continue;
+                        return;
+                    }
+                    //Zero is sent on destruction.
+                    if (value == 0) return;
+                    else if (value == SIGUSR1) latency.dump(std::cerr);
+                    else backend.stop();
+                }
+            });
+            std::signal(SIGUSR1, on_clipboard_signal);
+#endif
+            std::signal(SIGINT, on_clipboard_signal);
+            std::signal(SIGTERM, on_clipboard_signal);
+        }
+
+        ~ClipboardSignals() {
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+#ifdef _WIN32
+            std::signal(SIGBREAK, SIG_DFL);
+            signal_backend.store(nullptr);
+            signal_latency.store(nullptr);
+#else
+            std::signal(SIGUSR1, SIG_DFL);
+            if (!this->thread.joinable()) return;
+
+            on_clipboard_signal(0);
+            this->thread.join();
+            close(signal_pipe[0]);
+            close(signal_pipe[1]);
+#endif
+        }
+
+        ClipboardSignals(const ClipboardSignals&) = delete;
+        ClipboardSignals& operator=(const ClipboardSignals&) = delete;
+};
+
+///Cleans text on every change of clipboard, until backend is stopped.
+///
+///Changes are cleaned by own worker, so that during bursts only the newest text is cleaned.
+///Cleaned text is written by own writer, so that clipboard held by other application blocks neither of them.
+///Latency of each stage is dumped into stderr on SIGUSR1, or Ctrl+Break on Windows, and on exit.
+///
+///@param large Length of text, above which it is skipped or cleaned in chunks, 0 if there is no limit.
+///@param is_large_chunked Whether large text is cleaned line by line in background, instead of being skipped.
+///@returns Exit code.
+static inline int clean_clipboard(clipboard::Backend& backend, const text::Cleaner& cleaner, const Publish& publish, std::chrono::milliseconds debounce, size_t large, bool is_large_chunked) {
+    clipboard::Latency latency;
+
+    //Failure to set clipboard is usually temporary, as other application holds it.
+    clipboard::WriterOptions options;
+    options.latency = &latency;
+    options.on_failure = [](std::wstring_view) {
+        std::cerr << "Failed to set new clipboard!\n";
+    };
+    clipboard::Writer writer(backend, options);
+
+    std::unique_ptr<clipboard::Chunked> chunked;
+    if (is_large_chunked) {
+        chunked = std::make_unique<clipboard::Chunked>(cleaner, [&writer](std::wstring_view text) {
+            writer.write(text);
+        });
+    }
+
+    //Applications often set the same text again, which needs no clean.
+    clipboard::Repeats repeats;
+    std::unique_ptr<clipboard::Scheduler> scheduler;
+    //Hooked line is often copied over and over as it grows.
+    const auto cb = [&backend, &cleaner, &publish, &writer, &repeats, &chunked, &scheduler, &latency, large, state = text::Cleaner::Incremental(), cleaned = std::optional<std::wstring_view>(), last = std::wstring()]() mutable {
+        //Result is viewed in state, so it is copied only into writer.
+        std::optional<std::wstring_view> result;
+        bool is_new_line = false;
+        const auto changed_at = scheduler->changed_at();
+        const auto start = std::chrono::steady_clock::now();
+        latency.queue.record(start - changed_at);
+
+        //Text is viewed in place only during clean, so that clipboard is released before write.
+        backend.read([&](std::wstring_view text) {
+            latency.read.record(std::chrono::steady_clock::now() - start);
+            if (text.empty()) return;
+
+            //Large text, e.g. copied log, is never cleaned here, so that it does not delay ordinary lines.
+            if (large > 0 && text.size() > large) {
+                if (chunked) chunked->submit(std::wstring(text));
+                return;
+            }
+            if (chunked) chunked->cancel();
+
+            switch (repeats.find(text)) {
+                case clipboard::Repeats::Kind::Output:
+                    return;
+                case clipboard::Repeats::Kind::Input:
+                    //Raw text is back on clipboard, so the last result, which is still in state, is put back.
+                    result = cleaned;
+                    return;
+                case clipboard::Repeats::Kind::None:
+                    break;
+            }
+
+            //Clean is aborted as soon as newer text comes.
+            const auto clean_start = std::chrono::steady_clock::now();
+            result = cleaner.clean_view(text, state, scheduler->token());
+            latency.clean.record(std::chrono::steady_clock::now() - clean_start);
+            //Newer text is already coming, so there is no point to show this one.
+            if (scheduler->token().is_cancelled() || scheduler->is_stale()) {
+                //State is changed, so that the last result is not valid any more.
+                result.reset();
+                cleaned.reset();
+                repeats.forget();
+                return;
+            }
+            cleaned = result;
+            repeats.remember(text, result.value_or(text));
+
+            //Own write of cleaned text comes back as the same text.
+            const std::wstring_view line = result.has_value() ? *result : text;
+            if (publish && line != last) {
+                last.assign(line);
+                is_new_line = true;
+            }
+        });
+
+        if (result.has_value()) writer.write(*result, changed_at);
+        if (is_new_line) {
+            try {
+                publish(text::to_utf8_string(last));
+            }
+            catch (const std::range_error&) {
+                //Clipboard can have broken surrogates, which are not worth showing.
+            }
+        }
+    };
+    scheduler = std::make_unique<clipboard::Scheduler>(cb, debounce);
+
+    int result = 0;
+    {
+        const ClipboardSignals signals(backend, latency);
+        try {
+            backend.run([&scheduler]() {
+                scheduler->notify();
+            });
+        }
+        catch (const std::runtime_error& error) {
+            std::cerr << error.what() << "\n";
+            result = 1;
+        }
+    }
+
+    latency.dump(std::cerr);
+    return result;
 }
 
 static inline config::Config open_config(const char* file) {
@@ -31,23 +549,94 @@ int main(int argc, char* argv[]) {
 
     auto args = parser.parse(argc, argv);
 
-    const auto cleaner = init_cleaner(std::move(open_config(args.config.c_str())));
+    auto config = open_config(args.config.c_str());
 
-    const auto cb = [&cleaner]() {
-        const Clipboard clip;
-        const auto text = clip.get_wstring();
-        if (text.size() > 0) {
-            const auto result = cleaner.clean(text);
-            if (result.has_value()) {
-                while (!clip.set_string(*result)) {
-                    std::cerr << "Failed to set new clipboard! Try again...\n";
-                }
-            }
+    if (args.check) {
+        int result = check_rules(config);
+        for (const auto& profile : config.profiles) {
+            std::cout << "Profile '" << profile.first << "':\n";
+            result = std::max(result, check_rules(profile.second));
         }
-    };
+        return result;
+    }
+
+    warn_rules(config);
+    Profiles profiles;
+    for (auto& profile : config.profiles) {
+        warn_rules(profile.second);
+        profiles.emplace(profile.first, init_cleaner(std::move(profile.second)));
+    }
 
-    std::cout << "Start...\n";
-    ClipboardMaster(cb).run();
+    const auto cleaner = init_cleaner(std::move(config));
+
+    if (!args.input.empty()) {
+        return clean_file(args, cleaner);
+    }
+    else if (args.filter) {
+        return clean_filter(args, cleaner);
+    }
+#ifdef __linux__
+    else if (!args.serve.empty() || args.port != 0) {
+        return clean_serve(args, cleaner);
+    }
+#endif
+
+    Publish publish;
+#ifdef __linux__
+    //Broadcaster sends from own thread, so publishing adds nothing to latency of cleaning.
+    std::unique_ptr<service::Broadcaster> broadcaster;
+    if (!args.publish.empty() || args.publish_port != 0) {
+        try {
+            service::BroadcastOptions options;
+            options.socket_path = args.publish;
+            if (args.publish_port != 0) options.websocket_port = static_cast<uint16_t>(args.publish_port);
+            broadcaster = std::make_unique<service::Broadcaster>(options);
+        }
+        catch (const std::runtime_error& error) {
+            std::cerr << error.what() << "\n";
+            return 1;
+        }
+
+        publish = [&broadcaster](std::string_view line) {
+            broadcaster->publish(line);
+        };
+    }
+#else
+    if (!args.publish.empty() || args.publish_port != 0) {
+        std::cerr << "Publishing is not supported on this platform\n";
+        return 1;
+    }
+#endif
+
+    if (!args.follow.empty()) {
+        return clean_follow(args, cleaner, profiles, publish);
+    }
+    else if (!args.ring.empty()) {
+        return clean_ring(args, cleaner, profiles, publish);
+    }
+
+    std::unique_ptr<clipboard::Backend> backend;
+#ifdef _WIN32
+    if (!args.fifo.empty()) {
+        std::cerr << "Named pipe is not supported on this platform\n";
+        return 1;
+    }
+    backend = std::make_unique<clipboard::Win32>();
+#else
+    if (args.fifo.empty()) {
+        std::cerr << "There is no clipboard on this platform, use --fifo instead\n";
+        return 1;
+    }
+    try {
+        backend = std::make_unique<clipboard::Fifo>(args.fifo);
+    }
+    catch (const std::runtime_error& error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+#endif
 
-    return 0;
+    //Output of pipe goes into stdout.
+    (args.fifo.empty() ? std::cout : std::cerr) << "Start...\n";
+    return clean_clipboard(*backend, cleaner, publish, std::chrono::milliseconds(args.debounce), args.large, args.large_mode == "chunk");
 }
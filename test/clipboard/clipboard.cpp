@@ -0,0 +1,444 @@
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "clipboard/backend.hpp"
+#include "clipboard/chunked.hpp"
+#include "clipboard/latency.hpp"
+#include "clipboard/mailbox.hpp"
+#include "clipboard/repeats.hpp"
+#include "clipboard/scheduler.hpp"
+#include "clipboard/writer.hpp"
+#include "text/text.hpp"
+
+BOOST_AUTO_TEST_CASE(should_clean_simulated_clipboard) {
+    static constexpr size_t LINES = 1000;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    clipboard::Simulated clip;
+    std::vector<std::wstring> cleaned;
+    size_t calls = 0;
+
+    //Hook copies next line once it sees cleaned one and its change is handled, like reader would.
+    std::thread hook([&clip]() {
+        for (size_t idx = 0; idx < LINES; idx++) {
+            clip.copy(L"<b>行" + std::to_wstring(idx) + L"</b>");
+            while (clip.get() != L"行" + std::to_wstring(idx) || clip.dropped_count() != idx + 1) std::this_thread::yield();
+        }
+        clip.stop();
+    });
+
+    //The same loop as of main.
+    clip.run([&]() {
+        calls += 1;
+        const auto result = cleaner.clean(clip.get());
+        if (result.has_value()) {
+            BOOST_REQUIRE(clip.set(*result));
+            cleaned.push_back(*result);
+        }
+    });
+    hook.join();
+
+    //Own writes change clipboard as well, but they are not cleaned again.
+    BOOST_REQUIRE_EQUAL(cleaned.size(), LINES);
+    BOOST_REQUIRE_EQUAL(calls, LINES);
+    BOOST_REQUIRE_EQUAL(clip.change_count(), 2 * LINES);
+    BOOST_REQUIRE_EQUAL(clip.dropped_count(), LINES);
+    for (size_t idx = 0; idx < LINES; idx++) {
+        BOOST_REQUIRE(cleaned[idx] == L"行" + std::to_wstring(idx));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_keep_only_latest_value_in_mailbox) {
+    clipboard::Mailbox<int> mailbox;
+    BOOST_REQUIRE(!mailbox.has_value());
+
+    mailbox.post(1);
+    mailbox.post(2);
+    mailbox.post(3);
+    BOOST_REQUIRE(mailbox.has_value());
+    BOOST_REQUIRE_EQUAL(*mailbox.take(), 3);
+    BOOST_REQUIRE_EQUAL(mailbox.replaced_count(), 2);
+
+    //Values, that keep coming within debounce, replace the first one.
+    mailbox.post(4);
+    std::thread poster([&mailbox]() {
+        for (int value = 5; value <= 8; value++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            mailbox.post(value);
+        }
+    });
+    BOOST_REQUIRE_EQUAL(*mailbox.take(std::chrono::milliseconds(500)), 8);
+    poster.join();
+    BOOST_REQUIRE_EQUAL(mailbox.replaced_count(), 6);
+
+    //Callbacks run under lock, in order of post and take.
+    std::vector<std::string> calls;
+    mailbox.post(9, [&calls]() { calls.push_back("post"); });
+    BOOST_REQUIRE_EQUAL(*mailbox.take(std::chrono::steady_clock::duration::zero(), [&calls]() { calls.push_back("take"); }), 9);
+    mailbox.post(10, [&calls]() { calls.push_back("post"); });
+    BOOST_REQUIRE((calls == std::vector<std::string>{"post", "take", "post"}));
+
+    mailbox.close();
+    BOOST_REQUIRE(!mailbox.take().has_value());
+}
+
+BOOST_AUTO_TEST_CASE(should_recognize_repeated_clipboard_text) {
+    using Kind = clipboard::Repeats::Kind;
+
+    clipboard::Repeats repeats;
+    BOOST_REQUIRE(repeats.find(L"<b>一</b>") == Kind::None);
+
+    repeats.remember(L"<b>一</b>", L"一");
+    BOOST_REQUIRE(repeats.find(L"<b>一</b>") == Kind::Input);
+    BOOST_REQUIRE(repeats.find(L"一") == Kind::Output);
+    //The same length, but other text.
+    BOOST_REQUIRE(repeats.find(L"<b>二</b>") == Kind::None);
+    BOOST_REQUIRE(repeats.find(L"二") == Kind::None);
+    BOOST_REQUIRE_EQUAL(repeats.skipped_count(), 2);
+
+    //Text, that is already clean, is the same as its output.
+    const std::wstring clean(L"三");
+    repeats.remember(clean, clean);
+    BOOST_REQUIRE(repeats.find(L"三") == Kind::Output);
+
+    repeats.forget();
+    BOOST_REQUIRE(repeats.find(L"三") == Kind::None);
+    BOOST_REQUIRE_EQUAL(repeats.skipped_count(), 3);
+
+    BOOST_REQUIRE_EQUAL(clipboard::Repeats::hash(L""), 14695981039346656037ULL);
+    BOOST_REQUIRE(clipboard::Repeats::hash(L"ab") != clipboard::Repeats::hash(L"ba"));
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_only_latest_clipboard_text) {
+    static constexpr size_t LINES = 1000;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    clipboard::Simulated clip;
+    std::atomic<size_t> calls(0);
+    std::unique_ptr<clipboard::Scheduler> scheduler;
+    scheduler.reset(new clipboard::Scheduler([&]() {
+        calls.fetch_add(1);
+        const auto result = cleaner.clean(clip.get());
+        //Work takes a while, so that changes pile up meanwhile.
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        if (!scheduler->is_stale() && result.has_value()) clip.set(*result);
+    }));
+
+    const std::wstring last = L"行" + std::to_wstring(LINES - 1);
+    std::thread hook([&clip, &last]() {
+        for (size_t idx = 0; idx < LINES; idx++) {
+            clip.copy(L"<b>行" + std::to_wstring(idx) + L"</b>");
+        }
+        //Cleaned text of late work can overwrite the last copy, so it is copied again as hook would.
+        while (clip.get() != last) {
+            clip.copy(L"<b>" + last + L"</b>");
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        clip.stop();
+    });
+
+    clip.run([&scheduler]() {
+        scheduler->notify();
+    });
+    hook.join();
+    scheduler.reset();
+
+    BOOST_REQUIRE(clip.get() == last);
+    BOOST_REQUIRE(calls.load() > 0);
+    BOOST_REQUIRE(calls.load() < LINES);
+}
+
+namespace {
+    ///Clipboard, that other application holds for given number of writes.
+    class Busy : public clipboard::Simulated {
+        public:
+            std::atomic<unsigned> busy;
+            std::atomic<unsigned> attempts;
+
+            Busy() : busy(0), attempts(0) {}
+
+            bool set(std::wstring_view text) override {
+                this->attempts.fetch_add(1);
+                if (this->busy.load() > 0) {
+                    this->busy.fetch_sub(1);
+                    return false;
+                }
+                return clipboard::Simulated::set(text);
+            }
+    };
+
+    ///Clipboard, that remembers memory of each text, which is set.
+    class Recorder : public clipboard::Simulated {
+        public:
+            std::mutex lock;
+            std::set<const wchar_t*> buffers;
+
+            bool set(std::wstring_view text) override {
+                {
+                    const std::lock_guard<std::mutex> guard(this->lock);
+                    this->buffers.insert(text.data());
+                }
+                return clipboard::Simulated::set(text);
+            }
+    };
+
+    template<typename F>
+    void wait_until(F&& is_done) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!is_done()) {
+            BOOST_REQUIRE(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_retry_clipboard_write_with_backoff) {
+    Busy clip;
+    clipboard::WriterOptions options;
+    options.max_attempts = 4;
+    options.first_delay = std::chrono::milliseconds(5);
+    options.max_delay = std::chrono::milliseconds(20);
+    options.deadline = std::chrono::seconds(10);
+    std::atomic<unsigned> failures(0);
+    options.on_failure = [&failures](std::wstring_view) {
+        failures.fetch_add(1);
+    };
+    clipboard::Writer writer(clip, options);
+
+    //Held for a while, but not longer, than retries.
+    clip.busy = 3;
+    const auto start = std::chrono::steady_clock::now();
+    writer.write(L"一");
+    wait_until([&writer]() { return writer.stats().written == 1; });
+    //Delays are 5, 10 and 20 ms.
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(35));
+    BOOST_REQUIRE(clip.get() == L"一");
+    BOOST_REQUIRE_EQUAL(clip.attempts.load(), 4);
+    BOOST_REQUIRE_EQUAL(writer.stats().retries, 3);
+
+    //Held for longer, than attempt cap.
+    clip.busy = 100;
+    writer.write(L"二");
+    wait_until([&writer]() { return writer.stats().failed == 1; });
+    BOOST_REQUIRE_EQUAL(failures.load(), 1);
+    BOOST_REQUIRE_EQUAL(clip.attempts.load(), 8);
+    BOOST_REQUIRE(clip.get() == L"一");
+
+    //Newer text supersedes one, that waits for retry.
+    clip.busy = 1;
+    options.first_delay = std::chrono::seconds(10);
+    options.deadline = std::chrono::seconds(60);
+    clipboard::Writer slow(clip, options);
+    slow.write(L"三");
+    wait_until([&slow]() { return slow.stats().retries == 1; });
+    clip.busy = 0;
+    slow.write(L"四");
+    wait_until([&slow]() { return slow.stats().written == 1; });
+    BOOST_REQUIRE_EQUAL(slow.stats().superseded, 1);
+    BOOST_REQUIRE(clip.get() == L"四");
+
+    const auto stats = writer.stats();
+    BOOST_REQUIRE_EQUAL(stats.written, 1);
+    BOOST_REQUIRE_EQUAL(stats.failed, 1);
+    BOOST_REQUIRE_EQUAL(stats.superseded, 0);
+}
+
+BOOST_AUTO_TEST_CASE(should_give_up_clipboard_write_after_deadline) {
+    Busy clip;
+    clip.busy = 1000;
+    clipboard::WriterOptions options;
+    options.max_attempts = 1000;
+    options.first_delay = std::chrono::milliseconds(5);
+    options.deadline = std::chrono::milliseconds(50);
+
+    const auto start = std::chrono::steady_clock::now();
+    {
+        clipboard::Writer writer(clip, options);
+        writer.write(L"一");
+        wait_until([&writer]() { return writer.stats().failed == 1; });
+    }
+    BOOST_REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    BOOST_REQUIRE(clip.attempts.load() < 10);
+
+    //Deadline counts from change, so text, that is already late, is attempted once.
+    {
+        clipboard::Writer writer(clip, options);
+        const auto attempts = clip.attempts.load();
+        writer.write(L"三", std::chrono::steady_clock::now() - std::chrono::seconds(1));
+        wait_until([&writer]() { return writer.stats().failed == 1; });
+        BOOST_REQUIRE_EQUAL(clip.attempts.load(), attempts + 1);
+    }
+
+    //Pending text is still written on stop.
+    clip.busy = 0;
+    {
+        clipboard::Writer writer(clip, options);
+        writer.write(L"二");
+    }
+    BOOST_REQUIRE(clip.get() == L"二");
+}
+
+BOOST_AUTO_TEST_CASE(should_write_clipboard_through_reused_buffers) {
+    static constexpr size_t LINES = 1000;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+    text::Cleaner::Incremental state;
+    const text::Cancellation cancellation;
+
+    Recorder clip;
+    clipboard::Writer writer(clip);
+    for (size_t idx = 0; idx < LINES; idx++) {
+        const std::wstring line = L"<b>行" + std::to_wstring(LINES + idx) + L"</b>";
+        //Result is viewed in state, and text is copied only into buffer of writer.
+        const auto result = cleaner.clean_view(line, state, cancellation);
+        BOOST_REQUIRE(result.has_value());
+        BOOST_REQUIRE(*result == L"行" + std::to_wstring(LINES + idx));
+        writer.write(*result);
+        wait_until([&writer, idx]() { return writer.stats().written == idx + 1; });
+    }
+
+    //Buffers of writer are swapped and never grow, so no write allocates.
+    BOOST_REQUIRE(clip.get() == L"行" + std::to_wstring(2 * LINES - 1));
+    const std::lock_guard<std::mutex> guard(clip.lock);
+    BOOST_REQUIRE(clip.buffers.size() <= 2);
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_large_clipboard_text_by_lines) {
+    static constexpr size_t LINES = 20000;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"")
+           .emplace_back(text::Regex(L"^「(.+)」$"), L"$1");
+
+    std::wstring large;
+    std::wstring expected;
+    for (size_t idx = 0; idx < LINES; idx++) {
+        large += L"<b>" + std::to_wstring(idx) + L"</b>\n";
+        expected += std::to_wstring(idx) + L"\n";
+    }
+
+    std::mutex lock;
+    std::vector<std::wstring> results;
+    clipboard::Chunked chunked(cleaner, [&lock, &results](std::wstring_view text) {
+        const std::lock_guard<std::mutex> guard(lock);
+        results.emplace_back(text);
+    });
+
+    //Tag, that spans lines, is not seen, as each line is cleaned on its own.
+    chunked.submit(large + L"<b\n>末");
+    wait_until([&chunked]() { return chunked.stats().cleaned == 1; });
+
+    //Text, that is not changed, is not passed on.
+    chunked.submit(L"一\n二");
+    wait_until([&chunked]() { return chunked.stats().cleaned == 2; });
+
+    //Rules do not see `\r` of CRLF, which is kept as line end.
+    chunked.submit(L"「一」\r\n<b>二</b>\r\n");
+    wait_until([&chunked]() { return chunked.stats().cleaned == 3; });
+
+    //Newer text of ordinary size aborts large one.
+    chunked.submit(large);
+    chunked.cancel();
+    wait_until([&chunked]() { return chunked.stats().cancelled == 1; });
+
+    const std::lock_guard<std::mutex> guard(lock);
+    BOOST_REQUIRE_EQUAL(results.size(), 2);
+    BOOST_REQUIRE(results[0] == expected + L"<b\n>末");
+    BOOST_REQUIRE(results[1] == L"一\r\n二\r\n");
+    BOOST_REQUIRE_EQUAL(chunked.stats().cleaned, 3);
+}
+
+BOOST_AUTO_TEST_CASE(should_summarize_latency_histogram) {
+    //Bucket holds values, that are within 1/32 of each other.
+    for (uint64_t value : {0ULL, 1ULL, 31ULL, 32ULL, 33ULL, 1000ULL, 123456789ULL, ~0ULL}) {
+        const auto idx = clipboard::Histogram::index(value);
+        BOOST_REQUIRE(idx < clipboard::Histogram::BUCKETS);
+        BOOST_REQUIRE(clipboard::Histogram::highest(idx) >= value);
+        BOOST_REQUIRE(clipboard::Histogram::highest(idx) - value <= value / 32);
+    }
+
+    clipboard::Histogram histogram;
+    BOOST_REQUIRE_EQUAL(histogram.summary().count, 0);
+    BOOST_REQUIRE_EQUAL(histogram.percentile(0.5), 0);
+
+    for (uint64_t us = 1; us <= 1000; us++) {
+        histogram.record(std::chrono::microseconds(us));
+    }
+    const auto summary = histogram.summary();
+    BOOST_REQUIRE_EQUAL(summary.count, 1000);
+    BOOST_REQUIRE_EQUAL(summary.max, 1000000);
+    BOOST_REQUIRE(summary.p50 >= 500000 && summary.p50 <= 500000 + 500000 / 32);
+    BOOST_REQUIRE(summary.p90 >= 900000 && summary.p90 <= 900000 + 900000 / 32);
+    BOOST_REQUIRE(summary.p99 >= 990000 && summary.p99 <= 1000000);
+
+    clipboard::Latency latency;
+    latency.clean.record(std::chrono::microseconds(5));
+    std::ostringstream out;
+    latency.dump(out);
+    BOOST_REQUIRE(out.str().find("clean  count 1, p50 5.0us") != std::string::npos);
+    BOOST_REQUIRE(out.str().find("total  count 0\n") != std::string::npos);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(should_clean_clipboard_of_named_pipe) {
+    const auto path = (std::filesystem::temp_directory_path() / "vn-text-trim-test.fifo").string();
+    std::filesystem::remove(path);
+
+    int output[2];
+    BOOST_REQUIRE_EQUAL(pipe(output), 0);
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    {
+        clipboard::Fifo clip(path, output[1]);
+        BOOST_REQUIRE(std::filesystem::is_fifo(path));
+
+        const int writer = open(path.c_str(), O_WRONLY);
+        BOOST_REQUIRE(writer != -1);
+        const std::string input = "<b>一</b>\r\n\xff\n<i>二</i>\n<b>三";
+        BOOST_REQUIRE_EQUAL(write(writer, input.data(), input.size()), static_cast<ssize_t>(input.size()));
+
+        //Line is taken only once it is complete and broken one is skipped.
+        size_t count = 0;
+        clip.run([&]() {
+            count += 1;
+            BOOST_REQUIRE(clip.set(*cleaner.clean(clip.get())));
+            if (count == 2) clip.stop();
+        });
+        close(writer);
+    }
+    std::filesystem::remove(path);
+
+    close(output[1]);
+    std::string result;
+    char buffer[64];
+    for (ssize_t count; (count = read(output[0], buffer, sizeof(buffer))) > 0;) {
+        result.append(buffer, static_cast<size_t>(count));
+    }
+    close(output[0]);
+    BOOST_REQUIRE_EQUAL(result, "一\n二\n");
+
+    BOOST_REQUIRE_THROW(clipboard::Fifo("/nonexistent/vn-text-trim.fifo"), std::runtime_error);
+}
+#endif
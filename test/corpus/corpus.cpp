@@ -0,0 +1,374 @@
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "corpus/corpus.hpp"
+#include "corpus/file.hpp"
+#include "corpus/follow.hpp"
+#include "corpus/queue.hpp"
+#include "corpus/ring.hpp"
+#include "corpus/streams.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+BOOST_AUTO_TEST_CASE(should_pass_every_item_through_queue) {
+    static constexpr size_t PRODUCERS = 3;
+    static constexpr size_t ITEMS = 20000;
+
+    corpus::Queue<size_t> queue(8);
+    std::atomic<size_t> sum(0);
+
+    std::vector<std::thread> threads;
+    for (size_t producer = 0; producer < PRODUCERS; producer++) {
+        threads.emplace_back([&queue]() {
+            for (size_t item = 1; item <= ITEMS; item++) queue.push(size_t(item));
+        });
+        threads.emplace_back([&queue, &sum]() {
+            for (size_t item = 1; item <= ITEMS; item++) sum += queue.pop();
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    BOOST_REQUIRE_EQUAL(sum.load(), PRODUCERS * ITEMS * (ITEMS + 1) / 2);
+
+    size_t item = 0;
+    BOOST_REQUIRE(!queue.try_pop(item));
+}
+
+BOOST_AUTO_TEST_CASE(should_wake_parked_queue_threads) {
+    corpus::Queue<size_t> queue(2);
+
+    //Consumer parks on empty queue, till value is pushed.
+    size_t popped = 0;
+    std::thread consumer([&queue, &popped]() {
+        popped = queue.pop();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.push(1);
+    consumer.join();
+    BOOST_REQUIRE_EQUAL(popped, 1);
+
+    //Producer parks on full queue, till value is taken even without waiting.
+    queue.push(2);
+    queue.push(3);
+    std::thread producer([&queue]() {
+        queue.push(4);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    size_t value = 0;
+    BOOST_REQUIRE(queue.try_pop(value));
+    BOOST_REQUIRE_EQUAL(value, 2);
+    producer.join();
+
+    BOOST_REQUIRE_EQUAL(queue.pop(), 3);
+    BOOST_REQUIRE_EQUAL(queue.pop(), 4);
+    BOOST_REQUIRE(!queue.try_pop(value));
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_corpus_in_order) {
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"")
+           .emplace_back(text::Regex(L"^[「（](.+)[」 ）]$"), L"$1");
+
+    //Enough of lines to make several blocks.
+    std::string input;
+    std::string expected;
+    for (size_t idx = 0; input.size() < 5 * 1024 * 1024; idx++) {
+        const auto number = std::to_string(idx);
+        input.append("<color=#ffffff24>「御館様" + number + "」</color>\r\n");
+        expected.append("御館様" + number + "\r\n");
+    }
+    //Not valid UTF-8 is left as it is, so that its block is cleaned line by line.
+    input.append("\xff\xfe<b>\n");
+    expected.append("\xff\xfe<b>\n");
+    input.append("<b>行</b>\r\n");
+    expected.append("行\r\n");
+    //Last line without terminator.
+    input.append("<b>最後</b>");
+    expected.append("最後");
+
+    std::istringstream in(input);
+    std::ostringstream out;
+    const auto stats = corpus::process(in, out, cleaner, 3);
+
+    BOOST_REQUIRE(out.str() == expected);
+    BOOST_REQUIRE_EQUAL(stats.bytes_read, input.size());
+    BOOST_REQUIRE_EQUAL(stats.bytes_written, expected.size());
+    BOOST_REQUIRE_EQUAL(stats.lines, static_cast<uint64_t>(std::count(input.begin(), input.end(), '\n') + 1));
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_mapped_file) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input_path = (dir / "vn-text-trim-input.txt").string();
+    const auto output_path = (dir / "vn-text-trim-output.txt").string();
+
+    std::string input;
+    std::string expected;
+    for (size_t idx = 0; input.size() < 3 * 1024 * 1024; idx++) {
+        input.append("<b>行" + std::to_string(idx) + "</b>\n");
+        expected.append("行" + std::to_string(idx) + "\n");
+    }
+    std::ofstream(input_path, std::ios::binary) << input;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    {
+        const corpus::MappedFile mapped(input_path);
+        BOOST_REQUIRE(mapped.view() == input);
+
+        corpus::OutputFile output(output_path);
+        const auto stats = corpus::process(mapped.view(), [&output](std::string_view data) {
+            output.write(data);
+        }, cleaner, 2);
+        output.flush();
+
+        BOOST_REQUIRE(output.is_ok());
+        BOOST_REQUIRE_EQUAL(stats.bytes_read, input.size());
+        BOOST_REQUIRE_EQUAL(stats.lines, static_cast<uint64_t>(std::count(input.begin(), input.end(), '\n')));
+    }
+
+    std::ifstream result(output_path, std::ios::binary);
+    const std::string output((std::istreambuf_iterator<char>(result)), std::istreambuf_iterator<char>());
+    BOOST_REQUIRE(output == expected);
+
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+    BOOST_REQUIRE_THROW(corpus::MappedFile{input_path}, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(should_tell_same_file) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto path = (dir / "vn-text-trim-same.txt").string();
+    const auto other_path = (dir / "vn-text-trim-other.txt").string();
+
+    std::ofstream(path, std::ios::binary) << "一\n";
+    std::ofstream(other_path, std::ios::binary) << "一\n";
+
+    BOOST_REQUIRE(corpus::is_same_file(path, path));
+    BOOST_REQUIRE(corpus::is_same_file(path, (dir / "." / "vn-text-trim-same.txt").string()));
+    BOOST_REQUIRE(!corpus::is_same_file(path, other_path));
+    //Output, that does not exist yet, is created.
+    BOOST_REQUIRE(!corpus::is_same_file(path, (dir / "vn-text-trim-missing.txt").string()));
+    BOOST_REQUIRE(!corpus::is_same_file(path, ""));
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(other_path);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(should_read_pipe_instead_of_mapping) {
+    const auto path = (std::filesystem::temp_directory_path() / "vn-text-trim-pipe").string();
+    std::filesystem::remove(path);
+    BOOST_REQUIRE_EQUAL(mkfifo(path.c_str(), 0600), 0);
+
+    std::thread writer([&path]() {
+        std::ofstream(path, std::ios::binary) << "<b>一</b>\n二\n";
+    });
+    {
+        const corpus::MappedFile mapped(path);
+        BOOST_REQUIRE(mapped.view() == "<b>一</b>\n二\n");
+    }
+    writer.join();
+
+    std::filesystem::remove(path);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(should_filter_input_by_lines) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto input_path = (dir / "vn-text-trim-filter-input.txt").string();
+    const auto output_path = (dir / "vn-text-trim-filter-output.txt").string();
+
+    std::ofstream(input_path, std::ios::binary) << "<b>一</b>\n<i>二</i>\n三";
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    for (const auto buffering : {corpus::Buffering::Line, corpus::Buffering::Block}) {
+        {
+            corpus::InputFile input(input_path);
+            corpus::OutputFile output(output_path);
+            BOOST_REQUIRE(!input.is_interactive());
+
+            const auto stats = corpus::filter(input, output, cleaner, buffering, 2);
+            BOOST_REQUIRE(output.is_ok());
+            BOOST_REQUIRE_EQUAL(stats.lines, 3);
+        }
+
+        std::ifstream result(output_path, std::ios::binary);
+        const std::string output((std::istreambuf_iterator<char>(result)), std::istreambuf_iterator<char>());
+        BOOST_REQUIRE(output == "一\n二\n三");
+    }
+
+    std::filesystem::remove(input_path);
+    std::filesystem::remove(output_path);
+}
+
+BOOST_AUTO_TEST_CASE(should_follow_appended_lines) {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto path = (dir / "vn-text-trim-follow.log").string();
+    const auto rotated_path = (dir / "vn-text-trim-follow.log.1").string();
+
+    //Content before start is not followed.
+    std::ofstream(path, std::ios::binary) << "<b>古い</b>\n";
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::string output;
+
+    corpus::Follower follower(path);
+    std::thread thread([&]() {
+        corpus::follow(follower, [&](std::string_view data) {
+            const std::lock_guard<std::mutex> guard(lock);
+            output.append(data);
+            changed.notify_all();
+        }, cleaner);
+    });
+
+    const auto expect = [&](const std::string& expected) {
+        std::unique_lock<std::mutex> guard(lock);
+        BOOST_REQUIRE(changed.wait_for(guard, std::chrono::seconds(5), [&]() { return output == expected; }));
+    };
+
+    {
+        std::ofstream log(path, std::ios::binary | std::ios::app);
+        log << "<b>一</b>\n<i>二" << std::flush;
+        expect("一\n");
+        log << "</i>\n" << std::flush;
+        expect("一\n二\n");
+    }
+
+    //Truncated file is read from its start.
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "<b>三</b>\n";
+    expect("一\n二\n三\n");
+
+    //Rest of rotated file is read before new one.
+    std::filesystem::rename(path, rotated_path);
+    std::ofstream(rotated_path, std::ios::binary | std::ios::app) << "四";
+    std::ofstream(path, std::ios::binary) << "<b>五</b>\n";
+    expect("一\n二\n三\n四\n五\n");
+
+    follower.stop();
+    thread.join();
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(rotated_path);
+}
+
+BOOST_AUTO_TEST_CASE(should_consume_lines_from_ring) {
+    static constexpr size_t LINES = 10000;
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    //Few slots, so that producer has to wait for consumer.
+    corpus::RingConsumer consumer("vn-text-trim-test-ring", 4, 64);
+    //Ring of running consumer is not taken over.
+    BOOST_REQUIRE_THROW((corpus::RingConsumer{"vn-text-trim-test-ring", 4, 64}), std::runtime_error);
+    std::thread producer([]() {
+        corpus::RingProducer ring("vn-text-trim-test-ring");
+        BOOST_REQUIRE_THROW(ring.try_push(std::string(64, 'a')), std::length_error);
+
+        for (size_t idx = 0; idx < LINES; idx++) {
+            BOOST_REQUIRE(ring.push("<b>行" + std::to_string(idx) + "</b>"));
+        }
+        //Invalid UTF-8 is passed as it is.
+        BOOST_REQUIRE(ring.push("\xff<b>"));
+        ring.close();
+    });
+
+    std::string expected;
+    for (size_t idx = 0; idx < LINES; idx++) {
+        expected.append("行" + std::to_string(idx) + "\n");
+    }
+    expected.append("\xff<b>\n");
+
+    std::string output;
+    const auto stats = corpus::consume(consumer, [&output](std::string_view data) {
+        output.append(data);
+    }, cleaner);
+    producer.join();
+
+    BOOST_REQUIRE(output == expected);
+    BOOST_REQUIRE_EQUAL(stats.lines, LINES + 1);
+    BOOST_REQUIRE_THROW(corpus::RingProducer{"vn-text-trim-test-missing-ring"}, std::runtime_error);
+}
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_CASE(should_replace_ring_of_crashed_consumer) {
+    //Crashed consumer leaves its ring unlocked.
+    const int file = shm_open("/vn-text-trim-test-stale-ring", O_RDWR | O_CREAT, 0600);
+    BOOST_REQUIRE(file != -1);
+    close(file);
+
+    corpus::RingConsumer consumer("vn-text-trim-test-stale-ring", 4, 64);
+    {
+        corpus::RingProducer ring("vn-text-trim-test-stale-ring");
+        BOOST_REQUIRE(ring.push("行"));
+        ring.close();
+    }
+
+    std::string_view line;
+    BOOST_REQUIRE(consumer.next(line));
+    BOOST_REQUIRE(line == "行");
+    BOOST_REQUIRE(!consumer.next(line));
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(should_clean_streams_by_own_profiles) {
+    static constexpr size_t LINES = 2000;
+
+    text::Cleaner dialogue;
+    dialogue.emplace_back(text::Regex(L"<[^>]+>"), L"");
+    text::Cleaner names;
+    names.emplace_back(text::Regex(L"^【(.+)】$"), L"$1");
+
+    std::mutex lock;
+    std::map<std::string, std::vector<std::string>> output;
+    {
+        corpus::Streams streams(dialogue, [&lock, &output](std::string_view stream, std::string_view line) {
+            const std::lock_guard<std::mutex> guard(lock);
+            output[std::string(stream)].emplace_back(line);
+        }, 3);
+        streams.profile("names", names);
+
+        for (size_t idx = 0; idx < LINES; idx++) {
+            streams.submit("", "<b>行" + std::to_string(idx) + "</b>");
+            //Names repeat, so they are mostly taken from cache.
+            streams.submit("names", "【名" + std::to_string(idx % 5) + "】");
+            streams.submit("ui", "<i>" + std::to_string(idx) + "</i>\r");
+        }
+        streams.submit("ui", "\xff<b>");
+    }
+
+    BOOST_REQUIRE_EQUAL(output.size(), 3);
+    BOOST_REQUIRE_EQUAL(output[""].size(), LINES);
+    BOOST_REQUIRE_EQUAL(output["names"].size(), LINES);
+    BOOST_REQUIRE_EQUAL(output["ui"].size(), LINES + 1);
+    //Each stream keeps its order.
+    for (size_t idx = 0; idx < LINES; idx++) {
+        BOOST_REQUIRE_EQUAL(output[""][idx], "行" + std::to_string(idx));
+        BOOST_REQUIRE_EQUAL(output["names"][idx], "名" + std::to_string(idx % 5));
+        BOOST_REQUIRE_EQUAL(output["ui"][idx], std::to_string(idx) + "\r");
+    }
+    BOOST_REQUIRE_EQUAL(output["ui"].back(), "\xff<b>");
+}
@@ -0,0 +1,177 @@
+#ifdef __linux__
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "service/broadcast.hpp"
+#include "service/client.hpp"
+#include "service/protocol.hpp"
+#include "service/server.hpp"
+
+BOOST_AUTO_TEST_CASE(should_serve_cleaning_over_sockets) {
+    const auto socket_path = (std::filesystem::temp_directory_path() / "vn-text-trim-test.sock").string();
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    service::Options options;
+    options.socket_path = socket_path;
+    options.tcp_port = 0;
+    options.workers = 3;
+
+    service::Server server(cleaner, options);
+    BOOST_REQUIRE(server.port().has_value());
+    std::thread thread([&server]() {
+        server.run();
+    });
+
+    {
+        //Pipelined responses come in order of requests.
+        service::Client client(service::connect_unix(socket_path));
+        for (size_t idx = 0; idx < 500; idx++) {
+            client.send("<b>行" + std::to_string(idx) + "</b>");
+        }
+        for (size_t idx = 0; idx < 500; idx++) {
+            BOOST_REQUIRE_EQUAL(client.receive(), "行" + std::to_string(idx));
+        }
+
+        //Not valid UTF-8 is returned as it is.
+        BOOST_REQUIRE_EQUAL(client.clean("\xff<b>"), "\xff<b>");
+        BOOST_REQUIRE_EQUAL(client.clean(""), "");
+    }
+
+    {
+        std::vector<std::unique_ptr<service::Client>> clients;
+        for (size_t idx = 0; idx < 200; idx++) {
+            clients.emplace_back(new service::Client(idx % 2 == 0 ? service::connect_unix(socket_path) : service::connect_tcp(*server.port())));
+            clients.back()->send("<i>" + std::to_string(idx) + "</i>");
+        }
+        for (size_t idx = 0; idx < clients.size(); idx++) {
+            BOOST_REQUIRE_EQUAL(clients[idx]->receive(), std::to_string(idx));
+        }
+    }
+
+    {
+        //Responses are still sent after client has finished sending.
+        service::Client client(service::connect_tcp(*server.port()));
+        client.send("<b>一</b>");
+        client.send("<b>二</b>");
+        client.finish();
+        BOOST_REQUIRE_EQUAL(client.receive(), "一");
+        BOOST_REQUIRE_EQUAL(client.receive(), "二");
+        BOOST_REQUIRE_THROW(client.receive(), std::runtime_error);
+    }
+
+    {
+        //Too big request closes connection.
+        const int handle = service::connect_unix(socket_path);
+        const char header[] = "\xff\xff\xff\xff";
+        BOOST_REQUIRE_EQUAL(write(handle, header, service::HEADER_SIZE), static_cast<ssize_t>(service::HEADER_SIZE));
+        service::Client client(handle);
+        BOOST_REQUIRE_THROW(client.receive(), std::runtime_error);
+    }
+
+    server.stop();
+    thread.join();
+}
+
+static std::string read_exactly(int handle, size_t size) {
+    std::string result(size, '\0');
+    for (size_t done = 0; done < size;) {
+        const ssize_t count = read(handle, &result[done], size - done);
+        if (count <= 0) throw std::runtime_error("Connection is closed");
+        done += static_cast<size_t>(count);
+    }
+    return result;
+}
+
+///Subscribers are dropped by own thread of broadcaster.
+static void wait_subscribers(const service::Broadcaster& broadcaster, size_t size) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (broadcaster.subscribers_size() > size && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(should_broadcast_lines_to_subscribers) {
+    static constexpr size_t LINES = 4000;
+    const auto socket_path = (std::filesystem::temp_directory_path() / "vn-text-trim-test-publish.sock").string();
+
+    service::BroadcastOptions options;
+    options.socket_path = socket_path;
+    options.websocket_port = 0;
+    options.max_pending = 256 * 1024;
+
+    service::Broadcaster broadcaster(options);
+    BOOST_REQUIRE(broadcaster.port().has_value());
+    broadcaster.publish("一");
+
+    //The last line is received at once.
+    service::Client fast(service::connect_unix(socket_path));
+    BOOST_REQUIRE_EQUAL(fast.receive(), "一");
+    service::Client slow(service::connect_unix(socket_path));
+    BOOST_REQUIRE_EQUAL(slow.receive(), "一");
+
+    //Handshake example of RFC 6455.
+    const int websocket = service::connect_tcp(*broadcaster.port());
+    const std::string request = "GET /chat HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    BOOST_REQUIRE_EQUAL(write(websocket, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+    std::string response;
+    while (response.find("\r\n\r\n") == std::string::npos) {
+        response.append(read_exactly(websocket, 1));
+    }
+    BOOST_REQUIRE(response.find("101 Switching Protocols") != std::string::npos);
+    BOOST_REQUIRE(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    BOOST_REQUIRE_EQUAL(read_exactly(websocket, 2), std::string("\x81\x03", 2));
+    BOOST_REQUIRE_EQUAL(read_exactly(websocket, 3), "一");
+
+    //Line, that cannot be framed, is dropped.
+    broadcaster.publish(std::string(service::MAX_MESSAGE + 1, '.'));
+    BOOST_REQUIRE_EQUAL(broadcaster.dropped_count(), 1);
+
+    broadcaster.publish("二");
+    BOOST_REQUIRE_EQUAL(fast.receive(), "二");
+    BOOST_REQUIRE_EQUAL(read_exactly(websocket, 5), "\x81\x03二");
+    BOOST_REQUIRE_EQUAL(broadcaster.subscribers_size(), 3);
+
+    //Gone subscriber is noticed.
+    close(websocket);
+    wait_subscribers(broadcaster, 2);
+    BOOST_REQUIRE_EQUAL(broadcaster.subscribers_size(), 2);
+
+    //Subscribers, that don't read, are dropped, while the other keeps receiving everything.
+    std::vector<std::string> lines;
+    std::thread reader([&fast, &lines]() {
+        try {
+            while (lines.size() < LINES) lines.push_back(fast.receive());
+        }
+        catch (const std::runtime_error&) {
+        }
+    });
+    for (size_t idx = 0; idx < LINES; idx++) {
+        broadcaster.publish(std::to_string(idx) + std::string(1024, '.'));
+        //Lines come at pace, that reader can keep up with.
+        if (idx % 64 == 63) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    reader.join();
+    BOOST_REQUIRE_EQUAL(lines.size(), LINES);
+    for (size_t idx = 0; idx < LINES; idx++) {
+        BOOST_REQUIRE_EQUAL(lines[idx], std::to_string(idx) + std::string(1024, '.'));
+    }
+
+    wait_subscribers(broadcaster, 1);
+    BOOST_REQUIRE_EQUAL(broadcaster.subscribers_size(), 1);
+    //Lines, that were already in socket, can be still read, but not all of them.
+    size_t received = 0;
+    BOOST_REQUIRE_THROW(for (;; received++) slow.receive(), std::runtime_error);
+    BOOST_REQUIRE_LT(received, LINES);
+}
+#endif
@@ -1,13 +1,19 @@
 #include <boost/test/unit_test.hpp>
 
+#include <chrono>
+#include <thread>
+
 #include "text/text.hpp"
+#include "text/analysis.hpp"
+#include "text/stream.hpp"
+#include "config.hpp"
 
 BOOST_AUTO_TEST_CASE(should_clean_text) {
     const std::wstring expected_result(L"甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます");
     const std::wstring str(L"「甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます」");
 
     text::Cleaner cleaner;
-    cleaner.emplace_back(std::wregex(L"^[「（](.+)[」 ）]$"), L"$1");
+    cleaner.emplace_back(text::Regex(L"^[「（](.+)[」 ）]$"), L"$1");
 
     const auto result = cleaner.clean(str);
 
@@ -20,10 +26,284 @@ BOOST_AUTO_TEST_CASE(should_clean_reps_text) {
     const std::wstring str(L"御館様の想定通り、<color=#ffffff24>信濃勢は御館様の想定通り</color>、信濃勢は徹底抗戦の御館様の想定通り、信濃勢は徹底抗戦の構えを見御館様の想定通り、信濃勢は徹底抗戦の構えを見せた。");
 
     text::Cleaner cleaner;
-    cleaner.emplace_back(std::wregex(L"<[^>]+>"), L"")
-           .emplace_back(std::wregex(L".*(.+)\\1+"), L"$1");
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"")
+           .emplace_back(text::Regex(L".*(.+)\\1+"), L"$1");
+
+    const auto result = cleaner.clean(str);
+    BOOST_REQUIRE(result.has_value());
+    BOOST_REQUIRE(*result == expected_result);
+}
+
+BOOST_AUTO_TEST_CASE(should_find_literal) {
+    BOOST_REQUIRE(text::contains(L"御館様の想定通り", L"想定"));
+    BOOST_REQUIRE(text::contains(L"御館様の想定通り", L"通り"));
+    BOOST_REQUIRE(text::contains(L"御館様", L""));
+    BOOST_REQUIRE(!text::contains(L"御館様の想定通り", L"想通"));
+    BOOST_REQUIRE(!text::contains(L"御館", L"御館様"));
+}
+
+BOOST_AUTO_TEST_CASE(should_stop_on_terminal_rule) {
+    const std::wstring expected_result(L"<b>甘いもの</b>");
+    const std::wstring str(L"「<b>甘いもの</b>」");
+
+    text::Cleaner cleaner;
+    cleaner.push_back(std::move(text::Replacer(text::Regex(L"^「(.+)」$"), L"$1").stop(true)))
+           .emplace_back(text::Regex(L"<[^>]+>"), L"");
 
     const auto result = cleaner.clean(str);
     BOOST_REQUIRE(result.has_value());
     BOOST_REQUIRE(*result == expected_result);
 }
+
+BOOST_AUTO_TEST_CASE(should_skip_gated_rules) {
+    const std::wstring str(L"<b>甘いもの</b>");
+
+    text::Cleaner cleaner;
+    cleaner.push_back(std::move(text::Replacer(text::Regex(L"<[^>]+>"), L"").if_contains(L"<color")))
+           .push_back(std::move(text::Replacer(text::Regex(L"[<>]"), L"").unless_contains(L"</b>")));
+    BOOST_REQUIRE(!cleaner.clean(str).has_value());
+
+    text::Cleaner cleaner_if;
+    cleaner_if.push_back(std::move(text::Replacer(text::Regex(L"<[^>]+>"), L"").if_contains(L"<color").if_contains(L"<b>")));
+    const auto result = cleaner_if.clean(str);
+    BOOST_REQUIRE(result.has_value());
+    BOOST_REQUIRE(*result == L"甘いもの");
+}
+
+BOOST_AUTO_TEST_CASE(should_replace_as_std_regex) {
+    //Missing group `$9` is replaced with nothing, like std::regex does, unlike ECMAScript.
+    const text::Replacer groups(text::Regex(L"(\\w+)@(\\w+)"), L"$2 at $1 [$&] $$ $9");
+    BOOST_REQUIRE(groups.replace(L"douman@gmx, loli@waifu") == L"gmx at douman [douman@gmx] $ , waifu at loli [loli@waifu] $ ");
+
+    const text::Replacer empty(text::Regex(L"x*"), L"-");
+    BOOST_REQUIRE(empty.replace(L"abxc") == L"-a-b--c-");
+
+    const text::Replacer look(text::Regex(L"a(?=b)|c(?!d)"), L"_");
+    BOOST_REQUIRE(look.replace(L"ab ac cd ce") == L"_b a_ cd _e");
+
+    const text::Replacer lazy(text::Regex(L"<.+?>"), L"");
+    BOOST_REQUIRE(lazy.replace(L"<b>甘い</b>") == L"甘い");
+
+    BOOST_CHECK_THROW(text::Regex(L"(a"), std::runtime_error);
+    BOOST_CHECK_THROW(text::Regex(L"a**"), std::runtime_error);
+    BOOST_CHECK_THROW(text::Regex(L"(a)\\2"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(should_skip_rule_over_budget) {
+    //Text without repetitions makes pattern to try every split.
+    std::wstring expected_result;
+    for (wchar_t ch = 0x4E00; ch < 0x4E00 + 2000; ch++) {
+        expected_result.push_back(ch);
+    }
+    const std::wstring str(L"<b>" + expected_result + L"</b>");
+
+    text::Cleaner cleaner;
+    cleaner.push_back(std::move(text::Replacer(text::Regex(L".*(.+)\\1+"), L"$1").budget(text::Budget{10000, std::chrono::microseconds(0)})))
+           .emplace_back(text::Regex(L"<[^>]+>"), L"");
+
+    const auto result = cleaner.clean(str);
+    BOOST_REQUIRE(result.has_value());
+    BOOST_REQUIRE(*result == expected_result);
+    BOOST_REQUIRE(cleaner.stats().exhausted == 1);
+
+    text::Cleaner limited;
+    limited.emplace_back(text::Regex(L".*(.+)\\1+"), L"$1")
+           .emplace_back(text::Regex(L"<[^>]+>"), L"")
+           .budget(text::Budget{0, std::chrono::microseconds(1000)});
+
+    BOOST_REQUIRE(!limited.clean(str).has_value());
+    BOOST_REQUIRE(limited.stats().exhausted == 1);
+}
+
+///Same rules as in vn-text-trim.toml
+BOOST_AUTO_TEST_CASE(should_abort_cancelled_clean) {
+    //Text without repetitions makes pattern to try every split, which takes far too long without budget.
+    std::wstring str(L"<b>");
+    for (wchar_t ch = 0x4E00; ch < 0x4E00 + 2000; ch++) {
+        str.push_back(ch);
+    }
+    str.append(L"</b>");
+
+    text::Cleaner cleaner;
+    cleaner.emplace_back(text::Regex(L"<[^>]+>"), L"")
+           .emplace_back(text::Regex(L".*(.+)\\1+"), L"$1");
+
+    //Cancelled token stops clean before any rule.
+    text::Cancellation cancellation;
+    cancellation.cancel();
+    BOOST_REQUIRE(!cleaner.clean(str, cancellation).has_value());
+    BOOST_REQUIRE_EQUAL(cleaner.stats().cancelled, 1);
+
+    //Matcher notices cancellation in the middle of search.
+    cancellation.reset();
+    std::thread canceller([&cancellation]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        cancellation.cancel();
+    });
+    text::Cleaner::Incremental state;
+    BOOST_REQUIRE(!cleaner.clean(str, state, cancellation).has_value());
+    canceller.join();
+
+    const auto stats = cleaner.stats();
+    BOOST_REQUIRE_EQUAL(stats.cancelled, 2);
+    BOOST_REQUIRE_EQUAL(stats.exhausted, 0);
+    BOOST_REQUIRE(stats.cancelled_time >= std::chrono::milliseconds(20));
+
+    //State is still usable for the next text.
+    cancellation.reset();
+    BOOST_REQUIRE(*cleaner.clean(L"<b>甘い</b>", state, cancellation) == L"甘い");
+    BOOST_REQUIRE(*cleaner.clean(L"<b>甘いもの</b>", state, cancellation) == L"甘いもの");
+}
+
+///Cleaner with rules and budget of shipped config.
+static text::Cleaner default_cleaner() {
+    auto result = config::open(DEFAULT_CONFIG);
+    BOOST_REQUIRE(std::holds_alternative<config::Config>(result));
+
+    auto& config = std::get<config::Config>(result);
+    text::Cleaner cleaner(std::move(config.replace));
+    cleaner.budget(config.budget);
+    return cleaner;
+}
+
+BOOST_AUTO_TEST_CASE(should_analyze_complexity) {
+    typedef text::Analysis::Complexity Complexity;
+
+    BOOST_REQUIRE(text::analyze(text::Regex(L"^[「（](.+)[」 ）]$")).complexity == Complexity::Linear);
+    BOOST_REQUIRE(text::analyze(text::Regex(L"\\s")).complexity == Complexity::Linear);
+    BOOST_REQUIRE(text::analyze(text::Regex(L"^(a|ab)*c")).complexity == Complexity::Linear);
+
+    const auto nested = text::analyze(text::Regex(L"^(a+)+$"));
+    BOOST_REQUIRE(nested.complexity == Complexity::Exponential);
+    BOOST_REQUIRE(nested.pump == L"a");
+    BOOST_REQUIRE(text::analyze(text::Regex(L"(a|a)*b")).complexity == Complexity::Exponential);
+
+    const auto tag = text::analyze(text::Regex(L"<[^>]+>"));
+    BOOST_REQUIRE(tag.complexity == Complexity::Polynomial);
+    BOOST_REQUIRE_EQUAL(tag.degree, 2);
+
+    const auto dots = text::analyze(text::Regex(L"^.*.*.*x"));
+    BOOST_REQUIRE(dots.complexity == Complexity::Polynomial);
+    BOOST_REQUIRE_EQUAL(dots.degree, 3);
+
+    BOOST_REQUIRE(text::analyze(text::Regex(L".*(.+)\\1+")).complexity == Complexity::Polynomial);
+}
+
+BOOST_AUTO_TEST_CASE(should_measure_exponential_rule) {
+    const text::Replacer rule(text::Regex(L"^(a+)+$"), L"");
+    const auto samples = text::measure(rule, text::analyze(rule.regex()), std::chrono::milliseconds(20));
+
+    BOOST_REQUIRE(!samples.empty());
+    BOOST_REQUIRE(samples.back().exhausted);
+    BOOST_REQUIRE(samples.back().length < 1024);
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_huge_text) {
+#ifdef NDEBUG
+    static constexpr size_t SIZE = 10 * 1024 * 1024;
+#else
+    //Unoptimized build is several times slower, so it gets smaller dump within the same budget.
+    static constexpr size_t SIZE = 2 * 1024 * 1024;
+#endif
+
+    //Whole script dump copied at once.
+    std::wstring script;
+    script.reserve(SIZE + 64);
+    while (script.size() < SIZE) {
+        script.append(L"<color=#ffffff24>御館様</color>\n「甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます」\n");
+    }
+
+    const auto cleaner = default_cleaner();
+    const auto result = cleaner.clean(script);
+    BOOST_REQUIRE(result.has_value());
+    BOOST_REQUIRE(*result == L"甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます");
+
+    //Nothing to extract and no repetitions, so only budget stops it.
+    std::wstring garbage;
+    garbage.reserve(SIZE);
+    for (size_t idx = 0; garbage.size() < SIZE; idx++) {
+        garbage.push_back(static_cast<wchar_t>(0x4E00 + idx % 0x5000));
+        if (idx % 0x5000 == 0) garbage.push_back(L'\n');
+    }
+
+    BOOST_REQUIRE(cleaner.clean(garbage).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_stream_by_lines) {
+    const std::vector<std::wstring> lines{
+        L"<color=#ffffff24>御館様</color>",
+        L"「甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます」",
+        L"",
+        L"御館様の想定通り、信濃勢は徹底抗戦の構えを見せた。\r",
+        L"（最後の行）",
+    };
+
+    std::wstring script;
+    size_t longest = 0;
+    for (const auto& line : lines) {
+        script.append(line).push_back(L'\n');
+        longest = std::max(longest, line.size() + 1);
+    }
+    //Last line comes without terminator.
+    script.pop_back();
+
+    const auto cleaner = default_cleaner();
+
+    std::vector<std::wstring> result;
+    text::StreamCleaner stream(cleaner, [&result](std::wstring_view line) {
+        result.emplace_back(line);
+    });
+
+    for (size_t idx = 0; idx < script.size(); idx += 7) {
+        stream.feed(std::wstring_view(script).substr(idx, 7));
+        BOOST_REQUIRE(stream.pending_size() <= longest);
+    }
+    BOOST_REQUIRE_EQUAL(result.size(), lines.size() - 1);
+    stream.finish();
+    BOOST_REQUIRE_EQUAL(stream.pending_size(), 0);
+
+    BOOST_REQUIRE_EQUAL(result.size(), lines.size());
+    BOOST_REQUIRE(result[0] == L"御館様");
+    BOOST_REQUIRE(result[1] == L"甘いものは別腹と言いますから。私も見なかったこと作戦で食べちゃいます");
+    BOOST_REQUIRE(result[2] == L"");
+    BOOST_REQUIRE(result[3] == L"御館様の想定通り、信濃勢は徹底抗戦の構えを見せた。\r");
+    BOOST_REQUIRE(result[4] == L"最後の行");
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_growing_text_incrementally) {
+    const std::wstring line(L"<color=#ffffff24>御館様の想定通り</color>、信濃勢は 徹底抗戦の構えを見せた。「甘いものは別腹と言いますから」");
+    const auto cleaner = default_cleaner();
+
+    text::Cleaner::Incremental state;
+    for (size_t len = 1; len <= line.size(); len++) {
+        //Text is viewed in place, without terminating null.
+        const auto text = std::wstring_view(line).substr(0, len);
+        BOOST_REQUIRE(cleaner.clean(text, state) == cleaner.clean(std::wstring(text)));
+    }
+
+    //Unrelated text starts over.
+    const std::wstring other(L"「別の行」");
+    BOOST_REQUIRE(cleaner.clean(other, state) == cleaner.clean(other));
+}
+
+BOOST_AUTO_TEST_CASE(should_clean_batch_in_order) {
+    std::vector<std::wstring> texts;
+    for (size_t idx = 0; idx < 1000; idx++) {
+        texts.push_back(L"<color=#ffffff24>" + std::to_wstring(idx) + L"</color>\n「甘いもの" + std::wstring(idx % 50, L'は') + L"」");
+    }
+    texts.push_back(L"変わらない");
+
+    const auto cleaner = default_cleaner();
+    text::Pool pool(4);
+    const auto result = cleaner.clean_batch(texts, pool);
+
+    BOOST_REQUIRE_EQUAL(result.size(), texts.size());
+    for (size_t idx = 0; idx < texts.size(); idx++) {
+        BOOST_REQUIRE(result[idx] == cleaner.clean(texts[idx]));
+    }
+    BOOST_REQUIRE(!result.back().has_value());
+
+    //Pool is reusable.
+    BOOST_REQUIRE(cleaner.clean_batch(texts, pool) == result);
+    BOOST_REQUIRE(cleaner.clean_batch(std::vector<std::wstring>(), pool).empty());
+}